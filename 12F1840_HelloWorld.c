@@ -1,6 +1,8 @@
 // --------------------------------------------
 // Simple test code for the PIC 12F1840 which flashes an LED 
 // LED is on pin 5, RA2, connected via 560R resistor
+// The flash pattern is played from a table by the Timer2 interrupt, brightness is set
+// by the CCP1 PWM output which is on RA2, so no main loop time is used for the LED
 // Standard Pickit3 ICSP connections, MCLR to +5V via 10K resistor
 // Author: Steve Williams 18/05/2023
 // --------------------------------------------
@@ -32,21 +34,114 @@
 
 #define _XTAL_FREQ 32000000      // Define clock frequency used by xc8 __delay(time) functions
 
+// LED pattern sequencer definitions:
+#define LEDFULL 250              // PWM duty for full brightness, CCPR1L 0..250 with PR2 = 249
+#define PR2SETUP 249             // Timer2 period 250 x 2us = 500us, ie. 2kHz PWM
+#define T2CONSETUP 0x4E          // Postscale 1:10 (b6..3 = 1001), Timer2 on (b2), prescale 1:16 (b1..0 = 10)
+                                 // Timer2 interrupt every 10 x 500us = 5ms, the sequencer tick
+#define CCP1PWMMODE 0x0C         // CCP1CON CCP1M = 1100, single output PWM on CCP1 (RA2)
+
+// One step of an LED pattern, a pattern is an array of steps ended by a step with ticks = 0:
+typedef struct
+{
+    uint8_t ticks;               // Step duration in 5ms ticks, 1..255
+    uint8_t level;               // Brightness reached during the step, 0 = off .. LEDFULL
+    uint8_t fadeRate;            // Brightness change per tick towards level, 0 = change at once
+} ledStep_t;
+
+// Alternating short(0.1 sec) then long(1sec) flashes to indicate PIC is alive ... "Hello World"
+// followed by a fade up and down to show the brightness control:
+const ledStep_t ledHelloWorld[] = {{200, 0, 0}, {20, LEDFULL, 0}, {100, 0, 0}, {200, LEDFULL, 0},
+                                   {100, 0, 0}, {125, LEDFULL, 2}, {125, 0, 2}, {0, 0, 0}};
+
+// LED sequencer variables, shared with the ISR:
+const ledStep_t * volatile ledPattern = 0;  // Pattern being played, 0 = none
+volatile uint8_t ledStepIndex = 0;          // Current step in the pattern
+volatile uint8_t ledTicks = 0;              // Ticks remaining in the current step
+volatile uint8_t ledLevel = 0;              // Current brightness, written to CCPR1L
+volatile uint8_t ledRepeat = 0;             // If set pattern restarts at the end, else LED holds last level
+
+void __interrupt() ISR(void);
+void initialiseLEDsequencer(void);
+void ledPlayPattern(const ledStep_t *pattern, uint8_t repeat);
+
 void main(void)
 {                            // First set OSCCON to get 32 MHz maximum clock rate using the 4x PLL multiplier
     OSCCON = 0b11110000;     // SPLLEN = 4x PLL enable(b7,nb config overrides), IRCF=1110 (b6..3), SCS=00(1..0))
     PORTA = 0;               // Clear the outputs first
     TRISA = 0b11111011;      // Set TRIS, make RA2 an output to drive LED, bit 2 is cleared
+    initialiseLEDsequencer();
+    ledPlayPattern(ledHelloWorld, 1);
     while(1)
     {
-      __delay_ms(1000);            // Output alternating short(0.1 sec) then long(1sec) LED flashes
-      RA2 = 1;                     // to indicate PIC is alive ... "Hello World"
-      __delay_ms(100);             // This delay is 100 msec, uses inline compiler function
-      RA2 = 0;
-      __delay_ms(500);             // 0.5 sec
-      RA2 = 1;
-      __delay_ms(1000);            // 1 sec
-      RA2 = 0;
+                             // Nothing to do, the LED pattern is played by the Timer2 ISR
+    }
+}
+
+//***************************************************************************************
+// Interrupt service routine, Timer2 every 5ms steps the LED pattern:
+//***************************************************************************************
+
+void ISR(void)
+{
+    if (PIR1 & 0x02)                  // Check Timer2 interrupt flag bit 1 is set
+    {
+        PIR1 &= 0xFD;                 // Clear interrupt flag bit 1
+        if (ledPattern)
+        {
+            const ledStep_t *step = &ledPattern[ledStepIndex];
+            if (!step->fadeRate)                          // Step change of brightness
+                ledLevel = step->level;
+            else if (ledLevel < step->level)              // Fade up, stopping at the step level
+                ledLevel = (step->level - ledLevel > step->fadeRate) ? ledLevel + step->fadeRate : step->level;
+            else if (ledLevel > step->level)              // Fade down
+                ledLevel = (ledLevel - step->level > step->fadeRate) ? ledLevel - step->fadeRate : step->level;
+            CCPR1L = ledLevel;                            // PWM duty, new value used from next PWM period
+            if (--ledTicks == 0)                          // Step done, move on to the next step
+            {
+                ledStepIndex ++;
+                if (!ledPattern[ledStepIndex].ticks)      // End of pattern marker
+                {
+                    if (ledRepeat)
+                        ledStepIndex = 0;
+                    else
+                        ledPattern = 0;                   // Stop, LED holds the last brightness
+                }
+                if (ledPattern)
+                    ledTicks = ledPattern[ledStepIndex].ticks;
+            }
+        }
     }
 }
 
+/*********************************************************************************************
+  initialiseLEDsequencer() sets up Timer2 for both the 2kHz PWM and the 5ms sequencer tick,
+  CCP1 as PWM output on RA2 with the LED off, then enables the Timer2 interrupt
+*********************************************************************************************/
+void initialiseLEDsequencer(void)
+{
+    APFCON &= 0xFE;          // CCP1SEL (b0) clear, CCP1 output is on RA2
+    CCPR1L = 0;              // LED off, duty bits 1..0 in CCP1CON are left at 0
+    CCP1CON = CCP1PWMMODE;
+    PR2 = PR2SETUP;
+    TMR2 = 0;
+    PIR1 &= 0xFD;            // Clear Timer2 interrupt flag bit 1
+    T2CON = T2CONSETUP;
+    PIE1 |= 0x02;            // Timer2 interrupt enable bit 1
+    INTCON |= 0xC0;          // Enable interrupts, general - bit 7 plus peripheral - bit 6 
+}
+
+/*********************************************************************************************
+  ledPlayPattern() starts playing a pattern from its first step, replacing any pattern being 
+  played. The Timer2 interrupt is held off while the multi-byte sequencer state is changed
+*********************************************************************************************/
+void ledPlayPattern(const ledStep_t *pattern, uint8_t repeat)
+{
+    PIE1 &= 0xFD;            // Disable Timer2 interrupt
+    ledPattern = pattern;
+    ledStepIndex = 0;
+    ledTicks = pattern[0].ticks;
+    ledRepeat = repeat;
+    PIE1 |= 0x02;            // Enable Timer2 interrupt
+}
+
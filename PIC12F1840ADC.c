@@ -9,7 +9,7 @@
 // This code demonstrates use of the PICF1840 analogue to digital convertor (ADC)
 // with display of results on the TM1637 display. It can read one of the 4 
 // available analogue inputs AN0..3. Enable a pin as analogue input by setting it's
-// bit eg.for 2 ports: ADCinputConfig = 0b00000011. The voltage reference used is configurable
+// bit eg.for 2 ports: ADCINPUTPINS = 0b00000011. The voltage reference used is configurable
 // and this code uses the hardware fixed voltage reference (FVR). The FVR offers 3 voltages
 // according to the span required, set uint8_t ADCrefSelect to configure. Pre-configured ADC
 // channels may be selected on the fly in code, uint8_t ADCchannel controls.
@@ -19,7 +19,7 @@
 // Hardware configuration for the PIC 12F1840:
 // RA0 = AN0 analogue input 0
 // RA1 = AN1 analogue input 1
-// RA2 = OUT: LED via 560R resistor
+// RA2 = OUT: LED via 560R resistor, driven by CCP1 PWM for the LED pattern sequencer
 // RA3 = OUT: N/C
 // RA4 = IN/OUT: TM1637 DIO
 // RA5 = IN/OUT: TM1637 CLK
@@ -61,6 +61,16 @@
 #define tm1637dioTrisBit 4            // This is the bit shift to set TRIS for GP4
 #define tm1637clk RA5
 #define tm1637clkTrisBit 5
+#define TM1637POWERUPMS 100           // Upper bound on the TM1637 module power up, the 100ms the original code
+                                      // allowed for modules with bus capacitors, see TM1637 Capacitor Removal
+                                      // Info.pdf. The TM1637 datasheet gives no power up time
+#define TM1637POLLUS 3200             // One ACK poll, start + 1 byte + stop = 100us + 2.8ms + 300us
+#define TM1637POWERUPPOLLS (TM1637POWERUPMS * 1000UL / TM1637POLLUS)
+
+//Startup definitions:
+#define OSCREADYMASK 0x41             // OSCSTAT PLLR (b6) = 4x PLL ready, HFIOFS (b0) = HFINTOSC stable
+#define FVRREADYMASK 0x40             // FVRCON FVRRDY (b6) = fixed voltage reference ready
+#define ADCACQUISITIONUS 5            // ADC acquisition time (Tacq) allowed after selecting a channel
 
 //Timer1 definitions:
 #define T1PRESCALE 0x03                // 2 bits control, 01 = 1:2 used for 8 MHz clk, 11 = 1:8 for 32 MHz
@@ -69,12 +79,104 @@
 #define TIMER1LOWBYTE 0x60             // 50000 cycles @ 1:8 prescale == 50ms.
 #define TIMER1HIGHBYTE 0x3C            // Preload no delays = 65536-50000 = 15536 = 0x3C60
 
+//Timer2/CCP1 LED pattern sequencer definitions:
+#define LEDFULL 250                    // PWM duty for full brightness, CCPR1L 0..250 with PR2 = 249
+#define PR2SETUP 249                   // Timer2 period 250 x 2us = 500us, ie. 2kHz PWM
+#define T2CONSETUP 0x4E                // Postscale 1:10 (b6..3 = 1001), Timer2 on (b2), prescale 1:16 (b1..0 = 10)
+                                       // Timer2 interrupt every 10 x 500us = 5ms, the sequencer tick
+#define CCP1PWMMODE 0x0C               // CCP1CON CCP1M = 1100, single output PWM on CCP1 (RA2)
+#define ADCOVERRANGE 1023              // Full scale ADC count, input is at or above Vref
+
+// One step of an LED pattern, a pattern is an array of steps ended by a step with ticks = 0:
+typedef struct
+{
+    uint8_t ticks;                     // Step duration in 5ms ticks, 1..255
+    uint8_t level;                     // Brightness reached during the step, 0 = off .. LEDFULL
+    uint8_t fadeRate;                  // Brightness change per tick towards level, 0 = change at once
+} ledStep_t;
+
+// Blink codes, each is played once per ADC read so must be shorter than the 1 sec read interval:
+const ledStep_t ledReadFlash[] = {{20, LEDFULL, 0}, {25, 0, 10}, {0, 0, 0}};   // Read OK, flash and fade
+const ledStep_t ledOverrange[] = {{10, LEDFULL, 0}, {10, 0, 0}, {10, LEDFULL, 0}, {10, 0, 0},
+                                  {10, LEDFULL, 0}, {10, 0, 0}, {0, 0, 0}};  // ADC overrange, 3 fast flashes
+const ledStep_t ledAckFail[] = {{100, LEDFULL, 0}, {20, 0, 0}, {20, LEDFULL, 0}, {20, 0, 0}, 
+                                {0, 0, 0}};                  // No TM1637 ACK, long then short flash
+
+// LED sequencer variables, shared with the ISR:
+const ledStep_t * volatile ledPattern = 0;  // Pattern being played, 0 = none
+volatile uint8_t ledStepIndex = 0;          // Current step in the pattern
+volatile uint8_t ledTicks = 0;              // Ticks remaining in the current step
+volatile uint8_t ledLevel = 0;              // Current brightness, written to CCPR1L
+volatile uint8_t ledRepeat = 0;             // If set pattern restarts at the end, else LED holds last level
+
+//Sensor linearisation. lutLinearise() converts raw ADC counts to engineering units, eg. 0.1C for a
+//thermistor, by interpolating the sensorLUT[] table generated by host/lutGenerator.c from a sensor
+//curve description. Regenerate sensorLUT.h for a different sensor, divider or range.
+#define USESENSORLUT 0                 // Set 1 to display the linearised sensor value instead of mV
+#if USESENSORLUT
+#include "sensorLUT.h"
+#if SENSORLUTSHIFT < 2
+#error "sensorLUT.h step is below 4, lutLinearise() indexes the table with a uint8_t. Regenerate with step 4..256"
+#endif
+#endif
+
+//Interrupt dispatcher definitions. ISR() checks the enabled sources in a fixed priority order,
+//highest first, services one and returns. If another source is pending the core re-enters at 
+//once, so the highest priority pending source is always serviced next and waits for at most one
+//handler. Each handler clears its flag, does a short fixed piece of work and sets a flag for main().
+//Handlers are written inline in ISR(), not called, so no stack level or extra compiler context is
+//used, W, STATUS, BSR, FSRs and PCLATH are saved by the core's hardware shadow registers.
+//Priority order and reason:
+//  EUSART RX     2 byte receive FIFO overruns after 2 character times
+//  Timer1        Reload latency adds directly to the 50ms time base error
+//  ADC           Result holds in ADRES, but flag latency delays the read task
+//  EUSART TX     Only throughput is affected by latency
+//  Timer2        LED pattern, 5ms tick, a late step is not visible
+//  EEPROM        Write complete, ms timescale
+//  Comparator    Application dependent, lowest by default
+#define ISRUSEUART 0                   // Set 1 to compile in the EUSART transmitter, TX on RA0 so not with AN0
+#define ISRUSEUARTRX 0                 // Set 1 to also compile in the receiver, RX on RA1 so not with AN1 either
+#define ISRUSEEEPROM 0                 // Set 1 to compile in the EEPROM write complete handler
+#define ISRUSECOMPARATOR 0             // Set 1 to compile in the comparator handler
+#define ISRSOURCEUARTRX 0              // Index of each source in isrCount[]
+#define ISRSOURCETIMER1 1
+#define ISRSOURCEADC 2
+#define ISRSOURCEUARTTX 3
+#define ISRSOURCETIMER2 4
+#define ISRSOURCEEEPROM 5
+#define ISRSOURCECOMPARATOR 6
+#define ISRSOURCES 7
+// PIR1/PIE1 bits:
+#define TMR1IFMASK 0x01
+#define TMR2IFMASK 0x02
+#define TXIFMASK 0x10
+#define RCIFMASK 0x20
+#define ADIFMASK 0x40
+// PIR2/PIE2 bits:
+#define EEIFMASK 0x10
+#define C1IFMASK 0x20
+// RCSTA bits:
+#define OERRMASK 0x02
+#define CRENMASK 0x10
+
+//Interrupt dispatcher variables:
+volatile uint16_t isrCount[ISRSOURCES];        // Interrupts serviced per source, read with getISRcount()
+volatile uint8_t ADCdoneFlag = 0;              // Set by ISR when an ADC conversion completes
+#if ISRUSEUART && ISRUSEUARTRX
+volatile uint8_t uartRxByte = 0;               // Last byte received
+volatile uint8_t uartRxFlag = 0;               // Set by ISR when a byte is received
+#endif
+#if ISRUSEEEPROM
+volatile uint8_t eepromDoneFlag = 0;           // Set by ISR when an EEPROM write completes
+#endif
+#if ISRUSECOMPARATOR
+volatile uint8_t comparatorFlag = 0;           // Set by ISR when the comparator output changes
+#endif
+
 //General global variables:
 volatile uint8_t timer1Flag = 0;               // Flag is set by Timer 1 ISR every 50ms
 uint8_t ADCreadcounter = 0;                    // Counts intervals for ADC task in 50ms increments
 uint8_t ADCreadStatus = 0;                     // Stage of ADC conversion task, 0 = not started
-uint8_t LEDcounter = 0;                        // Used to time non-blocking LED flash in 50ms increments
-uint8_t LEDonTime = 0;                         // If true LED flash routine is called, flashes N x 50ms 
 
 //ADC definitions:
 #define NOCONVERSION 0
@@ -82,8 +184,97 @@ uint8_t LEDonTime = 0;                         // If true LED flash routine is c
 #define CONVERTING 2    
 
 //ADC variables:
-const uint8_t ADCinputConfig = 0b00000011; // Bit 0..4 set enables analogue input in PORTA, 
+#define ADCINPUTPINS 0b00000011
+const uint8_t ADCinputConfig = ADCINPUTPINS; // Bit 0..4 set enables analogue input in PORTA, 
                                            // and is used to set both TRISA and ANSELA, here AN0..1 enabled
+#if ISRUSEUART && (ADCINPUTPINS & 0x01)
+#error "ISRUSEUART: EUSART TX is on RA0 = AN0, the alternate pin RA4 is the TM1637. Remove AN0 from ADCINPUTPINS"
+#endif
+#if ISRUSEUART && ISRUSEUARTRX && (ADCINPUTPINS & 0x02)
+#error "ISRUSEUARTRX: EUSART RX is on RA1 = AN1, the alternate pin RA5 is the TM1637. Remove AN1 from ADCINPUTPINS"
+#endif
+#define ADCSAMPLECHANNEL 0             // Channel read and displayed by main(), AN0 = 0..AN3 = 3, set 1 with ISRUSEUART
+#define ADCCHANNELPIN(ch) ((ch) == 3 ? 0x10 : 1 << (ch))  // ADCINPUTPINS bit of a channel, AN3 is RA4
+#if !(ADCINPUTPINS & ADCCHANNELPIN(ADCSAMPLECHANNEL))
+#error "ADCSAMPLECHANNEL is not enabled as an analogue input in ADCINPUTPINS"
+#endif
+#if ISRUSEUART && ADCSAMPLECHANNEL == 0
+#error "ISRUSEUART: AN0 is the EUSART TX pin, set ADCSAMPLECHANNEL to 1"
+#endif
+#if ISRUSEUART && ISRUSEUARTRX && ADCSAMPLECHANNEL == 1
+#error "ISRUSEUARTRX: AN1 is the EUSART RX pin, no analogue input is left for ADCSAMPLECHANNEL"
+#endif
+
+//ADC statistics definitions:
+#define ADCNUMCHANNELS 2       // Statistics are kept for AN0..1, ie. the channels enabled in ADCinputConfig
+#define STATWINDOWS 2          // Number of windows per channel, each window has its own accumulator
+#define STATWINDOWSHORT 16     // Short window, blocks of 16 samples (16 sec at the 1 sec ADC read interval)
+#define STATWINDOWLONG 60      // Long window, blocks of 60 samples, 1 minute at 1 sample/sec
+#if STATWINDOWSHORT > 4096 || STATWINDOWLONG > 4096
+#error "Statistics window longer than 4096 samples, the sum of squares could overflow 32 bits"
+#endif
+#if ADCSAMPLECHANNEL >= ADCNUMCHANNELS
+#error "ADCSAMPLECHANNEL has no statistics, raise ADCNUMCHANNELS (48 bytes of RAM per channel)"
+#endif
+// Statistic selectors for the displayed value, set in displayStat:
+#define STATLIVE 0             // Latest sample, no statistics applied
+#define STATMIN 1
+#define STATMAX 2
+#define STATMEAN 3
+#define STATRMS 4
+
+//ADC statistics variables, all values are held as raw 10 bit ADC counts and converted to mV when read:
+typedef struct
+{
+    uint32_t sumSquares;       // Sum of squared samples, max 1023^2 x 4096 < 2^32
+    uint32_t sum;              // Sum of samples for the mean
+    uint16_t count;            // Samples accumulated so far in this window
+    uint16_t min;
+    uint16_t max;
+} ADCaccumulator_t;
+
+typedef struct
+{
+    uint16_t min;              // Results published at the end of each complete window
+    uint16_t max;
+    uint16_t mean;
+    uint16_t rms;
+    uint8_t valid;             // Set once the first window has completed
+} ADCstatResult_t;
+
+const uint16_t statWindowLength[STATWINDOWS] = {STATWINDOWSHORT, STATWINDOWLONG};
+ADCaccumulator_t ADCaccumulators[ADCNUMCHANNELS][STATWINDOWS];
+ADCstatResult_t ADCstatResults[ADCNUMCHANNELS][STATWINDOWS];
+uint16_t ADClatest[ADCNUMCHANNELS];    // Latest raw sample per channel, used for STATLIVE
+uint8_t displayStat = STATLIVE;        // Statistic shown by tm1637UpdateDisplay(), STATLIVE..STATRMS
+uint8_t displayWindow = 0;             // Window used for the displayed statistic, 0 = short, 1 = long
+
+//Sample stream codec definitions. Samples are sent as zigzag encoded deltas from the previous sample
+//of the channel, packed into 1 or 2 bytes, with a keyframe holding the full sample at intervals:
+//  0xxxxxxx           delta, zigzag value 0..127
+//  1000hhhh 0lllllll  delta, zigzag value 128..2047, hhhh = bits 10..7, lllllll = bits 6..0
+//  111100cc 0000hhh 0lllllll  keyframe for channel cc, 10 bit sample in hhh = bits 9..7, lllllll = bits 6..0
+//Bytes 0x90..0xEF and 0xF4..0xFF never occur, so 0xF0..0xF3 can only be a keyframe marker and a 
+//receiver joining the stream at any point is in sync from the next keyframe. Deltas belong to the
+//channel of the last keyframe, a keyframe is also sent whenever the encoded channel changes.
+#define CODECKEYMARKER 0xF0            // Keyframe marker byte, low 2 bits carry the ADC channel
+#define CODECKEYINTERVAL 32            // Samples per keyframe, including the keyframe itself
+#define CODECNOCHANNEL 0xFF            // codecLastChannel value forcing a keyframe
+#define CODECCHANNELS 4                // Channels a keyframe can carry, AN0..AN3
+#define TXBUFFERSIZE 16                // Transmit buffer size, must be a power of 2
+#define TXBUFFERMASK (TXBUFFERSIZE - 1)
+#define USESAMPLECODEC ISRUSEUART      // Compiles in the codec, only when a transmit routine drains txBuffer: the
+                                       // EUSART TX ISR on RA0 (ISRUSEUART) or a routine calling txBufferGet()
+
+#if USESAMPLECODEC
+//Sample stream codec variables:
+uint16_t codecPrevious[CODECCHANNELS];      // Last sample sent per channel, deltas are taken from this
+uint8_t codecCountdown[CODECCHANNELS];      // Deltas left to send before the next keyframe, 0 = keyframe next
+uint8_t codecLastChannel = CODECNOCHANNEL;  // Channel of the last keyframe sent
+uint8_t txBuffer[TXBUFFERSIZE];             // Encoded bytes waiting for the transmit routine
+volatile uint8_t txHead = 0;                // Next free position, written by encodeSample()
+volatile uint8_t txTail = 0;                // Next byte to send, read by txBufferGet() or EUSART TX ISR
+#endif
 
 
 //Display variables:
@@ -93,55 +284,110 @@ const uint8_t tm1637ByteSetOn = 0x88;          // 0x88 [10001000] = Display ON,
 const uint8_t tm1637ByteSetOff = 0x80;         // 0x80 [10000000] = Display OFF 
 const uint8_t tm1637MaxDigits = 4;
 const uint8_t tm1637RightDigit = tm1637MaxDigits - 1;
-// Used to output the segment data for numbers 0..9 :
-const uint8_t tm1637DisplayNumtoSeg[] = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f};
+// Used to output the segment data for numbers 0..9, then '-' :
+const uint8_t tm1637DisplayNumtoSeg[] = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f, 0x40};
+#define DISPLAYDASH 10                 // tm1637DisplayNumtoSeg[] index for '-'
 uint8_t tm1637Brightness = 5;         // Range 0 to 7
 uint8_t tm1637Data[] = {0, 0, 0, 0};  //Digit numeric data to display,array elements are for digits 0..3
 uint8_t decimalPointPos = 99;         //Flag for decimal point (digits counted from left),if > MaxDigits dp off// Digit flag for decimal point (digits counted from left),if > MaxDigits dp off
 uint8_t zeroBlanking = 0;             // If set true blanks leading zeros
 uint8_t numDisplayedDigits = 3;       // Limits total displayed digits, used after rounding a decimal value
+uint8_t tm1637AckFail = 0;            // Set by tm1637ByteWrite() if the module does not ACK a byte
 
-// ISR Handles Timer1 interrupt:
+// ISR dispatches all interrupt sources in priority order:
 void __interrupt() ISR(void);  // Note XC8 interrupt function setup syntax using __interrupt() + myisr()
+uint16_t getISRcount(uint8_t source);          // Interrupts serviced for a source, ISRSOURCEUARTRX..
+#if ISRUSEUART
+void initialiseUART(void);                     // EUSART 9600 baud TX, RX too if ISRUSEUARTRX
+#endif
 void initialise12F1840(void);
 void initialise12F1840ADC(uint8_t ADCrefSelect,uint8_t ADCchannel);      //Initialises the ADC
 void setADCchannel(uint8_t ADCchannel);        // Sets the ADC channel in use, 0..3 are valid values
-void LEDflash(void);
+void initialiseLEDsequencer(void);             // Timer2/CCP1 PWM setup for the LED pattern sequencer
+void ledPlayPattern(const ledStep_t *pattern, uint8_t repeat);
+void ledIndicateStatus(uint16_t ADCcounts);    // Selects the blink code for the ADC and display status
 uint16_t readADC(uint8_t ADCrefSelect);        // Returns ADC Vin in mV, ie 5000 max if Vref if Vref = 5V
+uint16_t readADCcounts(void);                  // Returns the raw 10 bit ADC result
+uint16_t ADCcountsTomV(uint16_t ADCcounts, uint8_t ADCrefSelect);
+void ADCstatsUpdate(uint8_t ADCchannel, uint16_t ADCcounts); // O(1) per sample statistics update
+uint16_t getADCstat(uint8_t ADCchannel, uint8_t window, uint8_t stat, uint8_t ADCrefSelect); // Result in mV
+uint16_t isqrt32(uint32_t value);              // Integer square root, used for RMS
+#if USESENSORLUT
+int16_t lutLinearise(uint16_t ADCcounts);      // Sensor value in sensorLUT.h units, shift and add interpolation
+#endif
+#if USESAMPLECODEC
+void encodeSample(uint8_t ADCchannel, uint16_t ADCcounts);  // Delta/keyframe encodes into txBuffer
+uint8_t txBufferGet(uint8_t *txByte);          // Gets the next encoded byte to send, 0 if none
+#endif
 void tm1637StartCondition(void);
 void tm1637StopCondition(void);
 uint8_t tm1637ByteWrite(uint8_t bWrite);
+uint8_t tm1637WaitReady(void);        // Polls the module for an ACK until it has powered up
 void tm1637UpdateDisplay(void);
 void tm1637DisplayOn(void);
 void tm1637DisplayOff(void);
 uint8_t getDigits(uint16_t number);   //Extracts decimal digits from integer, populates tm1637Data array
+#if USESENSORLUT
+void getSignedDigits(int16_t number); // As getDigits() with a '-' for negative numbers
+#endif
 void roundDigits(void);
 
 
 void main(void)
 {
-  uint8_t ADCchannel = 0;        // Active ADC channel, AN0 = 0..AN3 = 3, nb only 0 and 1 set up in this code
+  uint8_t ADCchannel = ADCSAMPLECHANNEL;  // Active ADC channel, AN0 = 0..AN3 = 3, the build checks it is set up
   const uint8_t ADCrefSelect = 0x03;  // Used to set FVR ADC ref volts ADFVR bits 1..0,nb ADC read/mV calc also uses
                                       // Valid values are 01=0x01: 1.024V, 10=0x02: 2.048V, 11=0x03: 4.096V
+  uint16_t ADCcounts = 0;        // Raw 10 bit ADC result, used for the overrange indication
+#if USESENSORLUT
+  int16_t sensorValue = 0;       // Linearised latest sample, negative values are displayed with a '-'
+#else
   uint16_t displayedInt=0;       // Beware 65K limit if larger than 4 digit display,consider using uint32_t
-  uint16_t ctr = 0;
+#endif
   
-  _delay(100);
-  initialise12F1840();
-  initialise12F1840ADC(ADCrefSelect, ADCchannel);
+  // Startup polls the hardware ready flags rather than using fixed delays. The first ADC reading
+  // is taken while the TM1637 module is still powering up so that the first display is a valid reading:
+  initialise12F1840();           // Returns as soon as the 32 MHz clock is stable, Timer1 then running
+  initialise12F1840ADC(ADCrefSelect, ADCchannel);  // Returns as soon as the FVR is ready
+#if ISRUSEUART
+  initialiseUART();
+#endif
+#if USESENSORLUT
+  zeroBlanking = 1;              // Display the sensor value with SENSORDECIMALS decimal places, eg. 25.3
+  decimalPointPos = SENSORDECIMALS ? tm1637RightDigit - SENSORDECIMALS : 99;
+  numDisplayedDigits = tm1637MaxDigits;
+#else
   zeroBlanking = 0;              // Don't blank leading zeros
   decimalPointPos = 0;           // Display 0-5000mV as n.nnn volts, digit 0 = leftmost
+#endif
+  __delay_us(ADCACQUISITIONUS);  // Allow Tacq for the channel selected by initialise12F1840ADC()
+  ADCdoneFlag = 0;
+  ADCON0 |= 0x02;                // Set GO/DONE, bit 1, to start the first conversion
+  while (!ADCdoneFlag);          // Conversion takes 11.5 Tad = 11.5us, flag set by ISR
+  ADCcounts = readADCcounts();
+  ADCstatsUpdate(ADCchannel, ADCcounts);
+#if USESAMPLECODEC
+  encodeSample(ADCchannel, ADCcounts);
+#endif
+#if USESENSORLUT
+  sensorValue = lutLinearise(ADCcounts);
+  getSignedDigits(sensorValue);
+#else
+  displayedInt = getADCstat(ADCchannel, displayWindow, displayStat, ADCrefSelect);
   getDigits(displayedInt);
-  tm1637UpdateDisplay();         // Display zero then start timed conversions, updating display as completed
+  roundDigits();
+#endif
+  initialiseLEDsequencer();
+  tm1637WaitReady();             // Waits only until the module ACKs, at most TM1637POWERUPMS
+  tm1637UpdateDisplay();         // Display the first reading then start timed conversions
+  ledIndicateStatus(ADCcounts);
   ADCreadcounter = 0;            // Start with timing counts at zero, both ADC read and timer1 flags
   timer1Flag = 0; 
-  T1CON |= TIMER1ON;
   while(1)
     {
       if (timer1Flag)
         {
-           ADCreadcounter ++;                    // Update task interval and LED timing flags
-           LEDcounter ++;                           
+           ADCreadcounter ++;                    // Update task interval timing flag
            timer1Flag = 0;                       // Clear the 50ms timing flag
         }
       
@@ -149,8 +395,6 @@ void main(void)
         { 
            ADCreadcounter = 0;
            ADCreadStatus = STARTADCREAD;         // Setting to 1 = start of ADC read 
-           LEDcounter = 0;                // Zero the LED time counter, note counts 50ms increments
-           LEDonTime = 1;                 // Sets up a 500ms LED flash
         }
       
       switch (ADCreadStatus)             // The ADC read/display task is managed by ADCreadStatus control flag
@@ -160,24 +404,34 @@ void main(void)
                   
               case STARTADCREAD:                 // nb. must only start ADC conversions after Taq since last
                   setADCchannel(ADCchannel);     // Channels 0..3 available if configured during initialisation
+                  ADCdoneFlag = 0;
                   ADCON0 |= 0x02;                        // Set GO/DONE, bit 1, to start conversion
                   ADCreadStatus = CONVERTING;
                   break;
                   
-              case CONVERTING:                   // Polls GO/DONE for completed conversion,COULD ADD TIMEOUT?
-                  if (!(ADCON0 & 0x02))
-                  {   // Get the raw ratiometric ADC data converted to Vin in mV:
-                      displayedInt = readADC(ADCrefSelect);       // Returns value as uint16_t
+              case CONVERTING:                   // Waits for the ISR to flag a completed conversion,COULD ADD TIMEOUT?
+                  if (ADCdoneFlag)
+                  {   // Update the channel statistics with the raw ADC data, then get the
+                      // selected statistic (or latest sample if STATLIVE) converted to Vin in mV:
+                      ADCcounts = readADCcounts();
+                      ADCstatsUpdate(ADCchannel, ADCcounts);
+#if USESAMPLECODEC
+                      encodeSample(ADCchannel, ADCcounts);  // Queue the sample for telemetry
+#endif
+#if USESENSORLUT
+                      sensorValue = lutLinearise(ADCcounts);   // Latest sample in sensor units
+                      getSignedDigits(sensorValue);
+#else
+                      displayedInt = getADCstat(ADCchannel, displayWindow, displayStat, ADCrefSelect);
                       getDigits(displayedInt);   // Extract digit data from integer into 4x uint8_t array 
                       roundDigits();             // Apply rounding to the array data if <4 digits displayed
+#endif
                       tm1637UpdateDisplay();
+                      ledIndicateStatus(ADCcounts);  // Blink code played by the Timer2 ISR
                       ADCreadStatus = NOCONVERSION;  // Consider adding a timed delay before reset this flag
                   }
                   break;
       }
-             
-      if (LEDonTime)                              // Call the LED flash function if a count is set
-          LEDflash();   
     }                       //while(1)
 }                           //main
 
@@ -189,32 +443,152 @@ void main(void)
 
 void ISR(void)
 {
-    if (PIR1 & 0x01)                  // Check Timer1 interrupt flag bit 0 is set
+    uint8_t pending = PIR1 & PIE1;    // Enabled sources only, flags are also set for disabled sources
+    
+#if ISRUSEUART && ISRUSEUARTRX
+    if (pending & RCIFMASK)           // EUSART receive, RCIF is cleared by reading RCREG
+    {
+        if (RCSTA & OERRMASK)         // Overrun stops the receiver, clear CREN to restart it
+        {
+            RCSTA &= ~CRENMASK;
+            RCSTA |= CRENMASK;
+        }
+        uartRxByte = RCREG;
+        uartRxFlag = 1;
+        isrCount[ISRSOURCEUARTRX] ++;
+        return;
+    }
+#endif
+    if (pending & TMR1IFMASK)         // Timer1 every 50ms
     {
-        PIR1 &= 0xFE;                 // Clear interrupt flag bit 0
+        PIR1 &= ~TMR1IFMASK;          // Clear interrupt flag bit 0
                                       // Reset Timer1 preload for 50ms overflow/interrupt(nb running timer)
         TMR1H = TIMER1HIGHBYTE;       // Note some timing inaccuracy due to interrupt latency + reload time
         TMR1L = TIMER1LOWBYTE;        // Correction was therefore applied to low byte to improve accuracy 
         timer1Flag = 1;               
-        
+        isrCount[ISRSOURCETIMER1] ++;
+        return;
+    }
+    if (pending & ADIFMASK)           // ADC conversion complete, result is read from ADRES by main()
+    {
+        PIR1 &= ~ADIFMASK;
+        ADCdoneFlag = 1;
+        isrCount[ISRSOURCEADC] ++;
+        return;
     }
+#if ISRUSEUART && USESAMPLECODEC
+    if (pending & TXIFMASK)           // EUSART TXREG empty, TXIF is cleared by writing TXREG
+    {
+        if (txTail != txHead)         // Send the next encoded sample byte
+        {
+            TXREG = txBuffer[txTail];
+            txTail = (txTail + 1) & TXBUFFERMASK;
+        }
+        else
+            PIE1 &= ~TXIFMASK;        // Nothing to send, encodeSample() enables again
+        isrCount[ISRSOURCEUARTTX] ++;
+        return;
+    }
+#endif
+    if (pending & TMR2IFMASK)         // Timer2 every 5ms, steps the LED pattern
+    {
+        PIR1 &= ~TMR2IFMASK;
+        if (ledPattern)
+        {
+            const ledStep_t *step = &ledPattern[ledStepIndex];
+            if (!step->fadeRate)                          // Step change of brightness
+                ledLevel = step->level;
+            else if (ledLevel < step->level)              // Fade up, stopping at the step level
+                ledLevel = (step->level - ledLevel > step->fadeRate) ? ledLevel + step->fadeRate : step->level;
+            else if (ledLevel > step->level)              // Fade down
+                ledLevel = (ledLevel - step->level > step->fadeRate) ? ledLevel - step->fadeRate : step->level;
+            CCPR1L = ledLevel;                            // PWM duty, new value used from next PWM period
+            if (--ledTicks == 0)                          // Step done, move on to the next step
+            {
+                ledStepIndex ++;
+                if (!ledPattern[ledStepIndex].ticks)      // End of pattern marker
+                {
+                    if (ledRepeat)
+                        ledStepIndex = 0;
+                    else
+                        ledPattern = 0;                   // Stop, LED holds the last brightness
+                }
+                if (ledPattern)
+                    ledTicks = ledPattern[ledStepIndex].ticks;
+            }
+        }
+        isrCount[ISRSOURCETIMER2] ++;
+        return;
+    }
+#if ISRUSEEEPROM || ISRUSECOMPARATOR
+    pending = PIR2 & PIE2;            // Lowest priority sources are in PIR2
+#endif
+#if ISRUSEEEPROM
+    if (pending & EEIFMASK)           // EEPROM write complete
+    {
+        PIR2 &= ~EEIFMASK;
+        eepromDoneFlag = 1;
+        isrCount[ISRSOURCEEEPROM] ++;
+        return;
+    }
+#endif
+#if ISRUSECOMPARATOR
+    if (pending & C1IFMASK)           // Comparator output changed
+    {
+        PIR2 &= ~C1IFMASK;
+        comparatorFlag = 1;
+        isrCount[ISRSOURCECOMPARATOR] ++;
+        return;
+    }
+#endif
 }
 
 //*******************************************************************************************
 //Functions: 
 //*******************************************************************************************
 
-void LEDflash(void)
+/*********************************************************************************************
+  initialiseLEDsequencer() sets up Timer2 for both the 2kHz PWM and the 5ms sequencer tick,
+  CCP1 as PWM output on RA2 with the LED off, then enables the Timer2 interrupt
+*********************************************************************************************/
+void initialiseLEDsequencer(void)
 {
-    if (LEDcounter <= LEDonTime)
-    {
-        RA2 = 1;                      // LED on
-    }
+    APFCON &= 0xFE;                   // CCP1SEL (b0) clear, CCP1 output is on RA2
+    CCPR1L = 0;                       // LED off, duty bits 1..0 in CCP1CON are left at 0
+    CCP1CON = CCP1PWMMODE;
+    PR2 = PR2SETUP;
+    TMR2 = 0;
+    PIR1 &= ~TMR2IFMASK;              // Clear Timer2 interrupt flag bit 1
+    T2CON = T2CONSETUP;
+    PIE1 |= TMR2IFMASK;               // Timer2 interrupt enable bit 1
+}
+
+/*********************************************************************************************
+  ledPlayPattern() starts playing a pattern from its first step, replacing any pattern being 
+  played. The Timer2 interrupt is held off while the multi-byte sequencer state is changed
+*********************************************************************************************/
+void ledPlayPattern(const ledStep_t *pattern, uint8_t repeat)
+{
+    PIE1 &= ~TMR2IFMASK;              // Disable Timer2 interrupt
+    ledPattern = pattern;
+    ledStepIndex = 0;
+    ledTicks = pattern[0].ticks;
+    ledRepeat = repeat;
+    PIE1 |= TMR2IFMASK;               // Enable Timer2 interrupt
+}
+
+/*********************************************************************************************
+  ledIndicateStatus() plays the blink code for the highest priority condition after each ADC
+  read and display update: TM1637 ACK failure, then ADC overrange, else a normal read flash
+*********************************************************************************************/
+void ledIndicateStatus(uint16_t ADCcounts)
+{
+    if (tm1637AckFail)
+        ledPlayPattern(ledAckFail, 0);
+    else if (ADCcounts >= ADCOVERRANGE)
+        ledPlayPattern(ledOverrange, 0);
     else
-    {
-        RA2 = 0;                      // LED off
-        LEDonTime = 0;                // Stop the flash
-    }
+        ledPlayPattern(ledReadFlash, 0);
 }
 
 //********************************************************************************************
@@ -232,14 +606,250 @@ void LEDflash(void)
 
 uint16_t readADC(uint8_t ADCrefSelect)  // Returns a 16 bit unsigned integer, Vin in mV
 {                                       // Very simple integer maths if use FVR as Vref, ie. 2^10mV .. 2^12mV
-    ADCrefSelect --;                    // Valid values 0x 01,02,03, if we decrement this calculates a net bitshift
+    return(ADCcountsTomV(readADCcounts(), ADCrefSelect));
+}
+
+uint16_t readADCcounts(void)            // Returns the raw 10 bit ADC result, 0..1023
+{
     uint16_t ADCval = ADRESL;           // ADC result is a 10 bit number, read lower 8 bits
     ADCval |= (uint16_t)ADRESH << 8;    // Get bits 8/9 of the result,storing as as 16 bit integer
-    uint16_t ADCmV = ADCval << ADCrefSelect; // Apply the net bitshift 0->2 for mV conversion, zero for 1024mV             
+    return(ADCval);
+}
+
+uint16_t ADCcountsTomV(uint16_t ADCcounts, uint8_t ADCrefSelect)
+{
+    ADCrefSelect --;                    // Valid values 0x 01,02,03, if we decrement this calculates a net bitshift
+    uint16_t ADCmV = ADCcounts << ADCrefSelect; // Apply the net bitshift 0->2 for mV conversion, zero for 1024mV             
     return(ADCmV);                      // Result OK as 16 bit integer as value in mV is less than 2^16(65536)  
 }
 
 
+//********************************************************************************************
+// ADCstatsUpdate() feeds one raw ADC sample into the min/max/mean/RMS accumulators for each
+// window of the channel. No samples are stored, each window keeps running sums which are 
+// published to ADCstatResults when the window is full, then cleared to start the next window.
+// Per sample cost is fixed: one 32 bit multiply for the square, shared by all windows, then 2 
+// compares and 2 adds per window. The divide and square root are only done once at the end of 
+// each window. Windows are consecutive blocks of samples, eg. the long window result is updated 
+// once a minute with that minute's statistics, so a result can be up to one window old.
+//********************************************************************************************
+
+void ADCstatsUpdate(uint8_t ADCchannel, uint16_t ADCcounts)
+{
+    if (ADCchannel >= ADCNUMCHANNELS)
+        return;                         // No accumulators, the build fails if ADCSAMPLECHANNEL is one of these
+    ADClatest[ADCchannel] = ADCcounts;
+    uint32_t square = (uint32_t)ADCcounts * ADCcounts;    // 10 bit x 10 bit, fits 20 bits
+    for (uint8_t window = 0; window < STATWINDOWS; window++)
+    {
+        ADCaccumulator_t *acc = &ADCaccumulators[ADCchannel][window];
+        if (acc->count == 0)            // First sample of a window sets both min and max
+        {
+            acc->min = ADCcounts;
+            acc->max = ADCcounts;
+        }
+        else if (ADCcounts < acc->min)
+            acc->min = ADCcounts;
+        else if (ADCcounts > acc->max)
+            acc->max = ADCcounts;
+        acc->sum += ADCcounts;
+        acc->sumSquares += square;
+        acc->count ++;
+        
+        if (acc->count >= statWindowLength[window])   // Window complete, publish and restart
+        {
+            ADCstatResult_t *result = &ADCstatResults[ADCchannel][window];
+            uint16_t halfCount = acc->count >> 1;       // Used to round the divisions to nearest
+            result->min = acc->min;
+            result->max = acc->max;
+            result->mean = (uint16_t)((acc->sum + halfCount) / acc->count);
+            result->rms = isqrt32((acc->sumSquares + halfCount) / acc->count);
+            result->valid = 1;
+            acc->sum = 0;
+            acc->sumSquares = 0;
+            acc->count = 0;
+        }
+    }
+}
+
+//********************************************************************************************
+// getADCstat() returns a channel statistic in mV for display or telemetry. Selectors for stat are
+// STATLIVE, STATMIN, STATMAX, STATMEAN and STATRMS, window is 0 (short) or 1 (long). Until the 
+// first window has completed the latest sample is returned for every statistic.
+//********************************************************************************************
+
+uint16_t getADCstat(uint8_t ADCchannel, uint8_t window, uint8_t stat, uint8_t ADCrefSelect)
+{
+    if (ADCchannel >= ADCNUMCHANNELS || window >= STATWINDOWS)
+        return 0;
+    uint16_t ADCcounts = ADClatest[ADCchannel];
+    ADCstatResult_t *result = &ADCstatResults[ADCchannel][window];
+    if (result->valid)
+    {
+        switch (stat)
+        {
+            case STATMIN:
+                ADCcounts = result->min;
+                break;
+            case STATMAX:
+                ADCcounts = result->max;
+                break;
+            case STATMEAN:
+                ADCcounts = result->mean;
+                break;
+            case STATRMS:
+                ADCcounts = result->rms;
+                break;
+        }
+    }
+    return(ADCcountsTomV(ADCcounts, ADCrefSelect));
+}
+
+//********************************************************************************************
+// isqrt32() integer square root by the bitwise shift and subtract method, no multiply or divide.
+// Used for RMS where the mean square of 10 bit data is < 2^20, so the result fits 10 bits.
+//********************************************************************************************
+
+uint16_t isqrt32(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;           // Highest power of 4 that fits 32 bits
+    while (bit > value)
+        bit >>= 2;
+    while (bit)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return((uint16_t)root);
+}
+
+#if USESENSORLUT
+//********************************************************************************************
+// lutLinearise() converts raw ADC counts to sensor units. The high bits of the count select a
+// sensorLUT[] segment, the low SENSORLUTSHIFT bits interpolate: value = base + delta x fraction / 32,
+// the multiply done by shift and add on the delta magnitude. Results are clamped to SENSORMIN..MAX.
+// About 130 cycles, 16us, against several thousand for the same conversion in float maths.
+// host/lutGenerator.c --check runs this same arithmetic against the exact curve.
+//********************************************************************************************
+
+int16_t lutLinearise(uint16_t ADCcounts)
+{
+    uint8_t index = (uint8_t)(ADCcounts >> SENSORLUTSHIFT);
+    uint8_t fraction = (uint8_t)ADCcounts & ((1 << SENSORLUTSHIFT) - 1);
+    int16_t base = sensorLUT[index];
+    int16_t delta = sensorLUT[index + 1] - base;
+    uint16_t magnitude = (delta < 0) ? (uint16_t)-delta : (uint16_t)delta;
+    uint16_t product = 0;
+    for (uint8_t bit = 0; bit < SENSORLUTSHIFT; bit ++)
+    {
+        if (fraction & 0x01)
+            product += magnitude;
+        fraction >>= 1;
+        magnitude <<= 1;
+    }
+    product = (product + (1 << (SENSORLUTSHIFT - 1))) >> SENSORLUTSHIFT;   // Rounded divide by 32
+    base = (delta < 0) ? base - (int16_t)product : base + (int16_t)product;
+    if (base < SENSORMIN)
+        return(SENSORMIN);
+    if (base > SENSORMAX)
+        return(SENSORMAX);
+    return(base);
+}
+#endif
+
+#if USESAMPLECODEC
+//********************************************************************************************
+// encodeSample() appends one raw ADC sample to txBuffer using the delta/keyframe format described
+// with the codec definitions. Cost is a subtract, a compare and 1-3 byte writes, no multiply or
+// divide. A sample is only queued if all its bytes fit, if not it is dropped and the next sample
+// of the channel is sent as a keyframe, so the receiver never applies a delta to a lost sample.
+// The bytes are sent by the EUSART TX ISR if ISRUSEUART is set, else by a transmit routine calling
+// txBufferGet(). Compiled in only if USESAMPLECODEC is set, with no transmit path the buffer would fill
+// after a few samples and every later call would fail.
+// Host side decoder and benchmark: host/sampleCodec.c
+//********************************************************************************************
+
+void encodeSample(uint8_t ADCchannel, uint16_t ADCcounts)
+{
+    if (ADCchannel >= CODECCHANNELS)
+        return;
+    uint8_t txFree = (txTail - txHead - 1) & TXBUFFERMASK;   // One slot kept empty, full != empty
+    if (codecCountdown[ADCchannel] == 0 || ADCchannel != codecLastChannel)
+    {
+        if (txFree < 3)
+        {
+            codecCountdown[ADCchannel] = 0;   // Dropped, keyframe next time
+            return;
+        }
+        txBuffer[txHead] = CODECKEYMARKER | ADCchannel;
+        txHead = (txHead + 1) & TXBUFFERMASK;
+        txBuffer[txHead] = (uint8_t)(ADCcounts >> 7);
+        txHead = (txHead + 1) & TXBUFFERMASK;
+        txBuffer[txHead] = (uint8_t)ADCcounts & 0x7F;
+        txHead = (txHead + 1) & TXBUFFERMASK;
+        codecLastChannel = ADCchannel;
+        codecCountdown[ADCchannel] = CODECKEYINTERVAL - 1;
+    }
+    else
+    {
+        int16_t delta = (int16_t)(ADCcounts - codecPrevious[ADCchannel]);
+        uint16_t zigzag;                      // Maps signed delta 0,-1,1,-2.. to 0,1,2,3..
+        if (delta < 0)
+            zigzag = ((uint16_t)(-delta) << 1) - 1;
+        else
+            zigzag = (uint16_t)delta << 1;
+        if (zigzag < 0x80)                    // Small delta, 1 byte
+        {
+            if (txFree < 1)
+            {
+                codecCountdown[ADCchannel] = 0;
+                return;
+            }
+            txBuffer[txHead] = (uint8_t)zigzag;
+            txHead = (txHead + 1) & TXBUFFERMASK;
+        }
+        else                                  // Large delta, 2 bytes
+        {
+            if (txFree < 2)
+            {
+                codecCountdown[ADCchannel] = 0;
+                return;
+            }
+            txBuffer[txHead] = 0x80 | (uint8_t)(zigzag >> 7);
+            txHead = (txHead + 1) & TXBUFFERMASK;
+            txBuffer[txHead] = (uint8_t)zigzag & 0x7F;
+            txHead = (txHead + 1) & TXBUFFERMASK;
+        }
+        codecCountdown[ADCchannel] --;
+    }
+    codecPrevious[ADCchannel] = ADCcounts;
+#if ISRUSEUART
+    PIE1 |= TXIFMASK;                         // EUSART TX ISR sends the queued bytes
+#endif
+}
+
+//********************************************************************************************
+// txBufferGet() gets the next encoded byte to transmit, returns 0 if the buffer is empty
+//********************************************************************************************
+
+uint8_t txBufferGet(uint8_t *txByte)
+{
+    if (txTail == txHead)
+        return 0;
+    *txByte = txBuffer[txTail];
+    txTail = (txTail + 1) & TXBUFFERMASK;
+    return 1;
+}
+#endif
+
+
 /*********************************************************************************************
  tm1637UpdateDisplay()
  Publish the tm1637Data array to the display
@@ -249,7 +859,9 @@ void tm1637UpdateDisplay()
     uint8_t tm1637DigitSegs = 0;
     uint8_t ctr;
     uint8_t stopBlanking = !zeroBlanking;            // Allow blanking of leading zeros if flag set
-            
+    
+    tm1637AckFail = 0;                               // Set again by tm1637ByteWrite() if any byte fails
+    
     // Write 0x40 [01000000] to indicate command to display data - [Write data to display register]:
     tm1637StartCondition();
     tm1637ByteWrite(tm1637ByteSetData);
@@ -261,7 +873,8 @@ void tm1637UpdateDisplay()
     for (ctr = 0; ctr < tm1637MaxDigits; ctr ++)
     {
         tm1637DigitSegs = tm1637DisplayNumtoSeg[tm1637Data[ctr]];
-        if (!stopBlanking && (tm1637Data[ctr]==0))  // Blank leading zeros if stop blanking flag not set
+        if (!stopBlanking && (tm1637Data[ctr]==0) && (ctr < decimalPointPos))  // Blank leading zeros if stop
+                                                    // blanking flag not set, a zero before the dp is kept
             {
                if (ctr < tm1637RightDigit)          // Never blank the rightmost digit
                   tm1637DigitSegs = 0;              // Segments set 0x00 gives blanked display numeral
@@ -341,9 +954,27 @@ void tm1637StopCondition()
 }
 
 
+/*********************************************************************************************
+ tm1637WaitReady()
+ Polls the module with the display data command until it ACKs, ie. has powered up, returns
+ 1 if it did. Gives up after TM1637POWERUPPOLLS, ~100ms, so a missing module does not hang
+*********************************************************************************************/
+uint8_t tm1637WaitReady(void)
+{
+    for (uint8_t poll = 0; poll < TM1637POWERUPPOLLS; poll++)
+    {
+        tm1637StartCondition();
+        uint8_t ack = tm1637ByteWrite(tm1637ByteSetData);
+        tm1637StopCondition();
+        if (ack)
+            return 1;
+    }
+    return 0;
+}
+
 /*********************************************************************************************
  tm1637ByteWrite(char bWrite)
- Write one byte
+ Write one byte, returns 1 if the module acknowledged the byte
 *********************************************************************************************/
 uint8_t tm1637ByteWrite(uint8_t bWrite) {
     for (uint8_t i = 0; i < 8; i++) {
@@ -382,12 +1013,14 @@ uint8_t tm1637ByteWrite(uint8_t bWrite) {
         TRISA &= ~(1<<tm1637dioTrisBit);  // Clear data tris bit
         tm1637dio = 0;
     }
+    else
+        tm1637AckFail = 1;                // Module did not pull DIO low, no ACK
     __delay_us(100);
     TRISA &= ~(1<<tm1637clkTrisBit);      // Clear clk tris bit, set clock low
     tm1637clk = 0;
     __delay_us(100);
 
-    return 1;
+    return !tm1637ack;                    // Returns 1 if the byte was acknowledged
 }
 
 
@@ -410,8 +1043,10 @@ void initialise12F1840()
     T1CON |= 0x04;                 // Bit 2 set enables disables external clock input 
     TMR1L = TIMER1LOWBYTE;         // Set Timer1 preload for 1ms overflow/interrupt
     TMR1H = TIMER1HIGHBYTE; 
-    PIE1 = 0x01;                   // Timer 1 interrupt enable bit 1 set, other interrupts disabled
-    PIR1 &= 0xFE;                  // Clear Timer1 interrupt flag bit 0
+    PIE1 = TMR1IFMASK;             // Timer 1 interrupt enable bit 0 set, ADC, Timer2 enabled by their setup
+    PIR1 &= ~TMR1IFMASK;           // Clear Timer1 interrupt flag bit 0
+    while ((OSCSTAT & OSCREADYMASK) != OSCREADYMASK);  // Wait for HFINTOSC stable and PLL lock, 2ms max
+    T1CON |= TIMER1ON;             // Timer1 is started here so it can also time the display power up
     INTCON |= 0xC0;                // Enable interrupts, general - bit 7 plus peripheral - bit 6 
 }
 
@@ -427,8 +1062,53 @@ void initialise12F1840ADC(uint8_t ADCrefSelect,uint8_t ADCchannel)
     ADCON0 = 0x01;                // ADC turned on (bit 0)
     ADCON0 |= ADCchannel<<2;      // Set the active ADC channel, bits 2..6 are CHS, 0 = AN0 ..3 = AN3
     ADCON1 = 0xA3; // ADFM b7 set = R justified. ADCS = 010, Tad = Fosc/32 = 1.0us @32MHz.Vref = Vdd, internal ref
+    PIR1 &= ~ADIFMASK;            // Clear ADC interrupt flag bit 6
+    PIE1 |= ADIFMASK;             // ADC interrupt enable, conversion complete is flagged by the ISR
+    while (!(FVRCON & FVRREADYMASK));  // Wait until FVR output is stable before any conversion
+}
+
+
+/*************************************************************************************************
+ * getISRcount() returns the number of interrupts serviced for a source, eg. ISRSOURCETIMER1, to 
+ * show interrupt load. Counts wrap at 65536. Interrupts are held off for the 2 byte read.
+ * ***********************************************************************************************/
+uint16_t getISRcount(uint8_t source)
+{
+    if (source >= ISRSOURCES)
+        return 0;
+    uint8_t gieState = INTCON & 0x80;  // Save GIE, bit 7, so interrupts are only enabled again if they were on
+    INTCON &= 0x7F;               // Clear GIE
+    uint16_t count = isrCount[source];
+    INTCON |= gieState;
+    return(count);
 }
 
+#if ISRUSEUART
+/*************************************************************************************************
+ * initialiseUART() sets the EUSART for 9600 baud 8N1 with TX on RA0, the default pin. The receiver
+ * stays off so RA1 can still be AN1, unless ISRUSEUARTRX is set, then RX is on RA1, set digital
+ * and an input. The build fails if AN0, or AN1 with RX, is still in ADCINPUTPINS.
+ * TX interrupts are enabled by encodeSample()
+ * ***********************************************************************************************/
+void initialiseUART(void)
+{
+    APFCON &= 0x7B;               // TXCKSEL (b2) and RXDTSEL (b7) clear, TX on RA0, RX on RA1
+    ANSELA &= 0xFE;               // RA0 digital for TX
+    BAUDCON = 0x08;               // BRG16 (b3) set, 16 bit baud rate generator
+    SPBRGH = 0x03;                // Baud = Fosc/(4 x (SPBRG + 1)), 32MHz/(4 x 833) = 9604
+    SPBRGL = 0x40;                // SPBRG = 832 = 0x0340
+    TXSTA = 0x24;                 // TXEN (b5) and BRGH (b2) set
+#if ISRUSEUARTRX
+    ANSELA &= 0xFD;               // RA1 digital, else RX always reads 0
+    TRISA |= 0x02;                // RX input, TX output is set by the EUSART
+    RCSTA = 0x90;                 // SPEN (b7) and CREN (b4) set, serial port and receiver on
+    PIE1 |= RCIFMASK;             // Receive interrupt enable
+#else
+    RCSTA = 0x80;                 // SPEN (b7) set, CREN clear, transmit only
+#endif
+}
+#endif
+
 
 /*************************************************************************************************
  * setADCchannel() sets the ADC channel in use, AN0..AN3. Channel = 0..3. Must configure i/o pin as an
@@ -471,6 +1151,34 @@ uint8_t getDigits(uint16_t number)
     return 1;
 }
 
+#if USESENSORLUT
+/*************************************************************************************************
+ getSignedDigits() is getDigits() for a signed number. A negative number has a '-' in the leftmost
+ digit that leading zero blanking would clear, so is used with zeroBlanking set, eg. " -5.3". If no
+ digit is free, eg. -100.0 on 4 digits, '----' is displayed.
+ ************************************************************************************************/
+
+void getSignedDigits(int16_t number)
+{
+    uint8_t ctr = 0;
+    if (number >= 0)
+    {
+        getDigits((uint16_t)number);
+        return;
+    }
+    getDigits(0 - (uint16_t)number);
+    while ((ctr < tm1637RightDigit) && (tm1637Data[ctr] == 0) && (ctr < decimalPointPos))
+        ctr ++;                                 // First digit that is displayed
+    if (ctr == 0)
+    {
+        for (; ctr < tm1637MaxDigits; ctr++)
+            tm1637Data[ctr] = DISPLAYDASH;
+    }
+    else
+        tm1637Data[ctr - 1] = DISPLAYDASH;
+}
+#endif
+
 //*****************************************************************************************
 // roundDigits applies decimal rounding to digit data stored in tm1637Data array
 // processing the digit data from right (least significant) to left. As written 
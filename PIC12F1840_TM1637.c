@@ -50,6 +50,12 @@
 #define tm1637dioTrisBit 4            // This is the bit shift to set TRIS for GP4
 #define tm1637clk RA5
 #define tm1637clkTrisBit 5
+#define TM1637POWERUPMS 100           // Upper bound on the TM1637 module power up, the 100ms the original code
+                                      // allowed for modules with bus capacitors, see TM1637 Capacitor Removal
+                                      // Info.pdf. The TM1637 datasheet gives no power up time
+#define TM1637POLLUS 3200             // One ACK poll, start + 1 byte + stop = 100us + 2.8ms + 300us
+#define TM1637POWERUPPOLLS (TM1637POWERUPMS * 1000UL / TM1637POLLUS)
+#define OSCREADYMASK 0x41             // OSCSTAT PLLR (b6) = 4x PLL ready, HFIOFS (b0) = HFINTOSC stable
 
 //Variables:
 
@@ -71,6 +77,7 @@ void initialise(void);
 void tm1637StartCondition(void);
 void tm1637StopCondition(void);
 uint8_t tm1637ByteWrite(uint8_t bWrite);
+uint8_t tm1637WaitReady(void);        // Polls the module for an ACK until it has powered up
 void tm1637UpdateDisplay(void);
 void tm1637DisplayOn(void);
 void tm1637DisplayOff(void);
@@ -82,8 +89,10 @@ void main(void)
   uint16_t displayedInt=0;  // Beware 65K limit if larger than 4 digit display,consider using uint32_t
   uint16_t ctr = 0;
   initialise();             // Will initialise the 12F1840 with 32MHz clock, TRIS configured,ADC disabled
-  __delay_ms(100);
   getDigits(displayedInt);
+  tm1637WaitReady();             // Waits only until the module ACKs, at most TM1637POWERUPMS. Reset to
+                                 // first display is calculated, not measured, as ~23ms if the module ACKs
+                                 // at once: 2ms PLL lock + 3.2ms poll + 17.8ms write, at most ~120ms
   tm1637UpdateDisplay();
   while(1)
     {
@@ -195,9 +204,27 @@ void tm1637StopCondition()
 }
 
 
+/*********************************************************************************************
+ tm1637WaitReady()
+ Polls the module with the display data command until it ACKs, ie. has powered up, returns
+ 1 if it did. Gives up after TM1637POWERUPPOLLS, ~100ms, so a missing module does not hang
+*********************************************************************************************/
+uint8_t tm1637WaitReady(void)
+{
+    for (uint8_t poll = 0; poll < TM1637POWERUPPOLLS; poll++)
+    {
+        tm1637StartCondition();
+        uint8_t ack = tm1637ByteWrite(tm1637ByteSetData);
+        tm1637StopCondition();
+        if (ack)
+            return 1;
+    }
+    return 0;
+}
+
 /*********************************************************************************************
  tm1637ByteWrite(char bWrite)
- Write one byte
+ Write one byte, returns 1 if the module acknowledged the byte
 *********************************************************************************************/
 uint8_t tm1637ByteWrite(uint8_t bWrite) {
     for (uint8_t i = 0; i < 8; i++) {
@@ -241,7 +268,7 @@ uint8_t tm1637ByteWrite(uint8_t bWrite) {
     tm1637clk = 0;
     __delay_us(100);
 
-    return 1;
+    return !tm1637ack;                     // Returns 1 if the byte was acknowledged
 }
 
 
@@ -257,6 +284,7 @@ void initialise()
     ANSELA = 0;                     // Configure A/D inputs as digital I/O
     CM1CON0 = 7;                    // Comparator off
     OPTION_REG = 0b10001000;        // Set bit 7, disable pullups, plus bit 3, prescaler not assigned Timer0
+    while ((OSCSTAT & OSCREADYMASK) != OSCREADYMASK);  // Wait for HFINTOSC stable and PLL lock, 2ms max
 }
 
 
@@ -0,0 +1,632 @@
+// ---------------------------------------------------------------------
+// Microchip 12F1840/TM1637 frequency, period and duty cycle meter by Steve Williams
+// for Microchip's MPLAB XC8 compiler. The TM1637 routines were originally
+// written by electro-dan for the BoostC compiler as part of project:
+// https://github.com/electro-dan/PIC12F_TM1637_Thermometer, ported for the PIC12F1840.
+// The input signal is timed in hardware, Timer1 counts Fosc/4 = 8MHz (125ns resolution).
+// Measurements alternate between two phases, each ending after a ~100ms window:
+//  PERIOD    CCP1 captures Timer1 on rising edges, every 16th rising edge for signals above
+//            20kHz. Timer1 overflows extend the count to 32 bits. Edges and the Timer1 ticks
+//            between the first and last capture give the mean period and frequency.
+//  HIGHTIME  Timer1 gate single pulse mode, Timer1 counts only while the T1G input is high.
+//            The ISR rearms the gate after each pulse, total ticks / pulses is the mean high time.
+// The ISR buffers the completed measurements, main() only formats and displays them so the
+// blocking TM1637 code does not affect the measurement.
+// Range and accuracy: 0.5Hz (2s no signal timeout) to ~1.5MHz, limited by the capture ISR
+// which must finish within 16 input periods. The ISR is estimated at ~80 cycles = 10us, not
+// measured, so the upper limit is an estimate. If a capture arrives before the ISR has handled
+// the last one the period phase is discarded and retried capturing every 16th edge, or '----' is
+// shown if already at 1:16. Resolution is 1 tick in the 100ms window, 1.25ppm, so accuracy is
+// that of the HFINTOSC: +/-1% at 25C, +/-2% 0-60C.
+// High time is measured to +/-1 tick per pulse, averaged over up to 1000 pulses.
+// No warranty is implied and the code is for test use at users own risk.
+//
+// Hardware configuration for the PIC 12F1840:
+// RA0 = OUT: N/C
+// RA1 = OUT: N/C
+// RA2 = IN: Signal input, CCP1
+// RA3 = IN: Signal input, T1G, link to RA2 (MCLR disabled)
+// RA4 = IN/OUT: TM1637 DIO
+// RA5 = IN/OUT: TM1637 CLK
+// -----------------------------------------------------------------------
+
+
+#include <xc.h>                   // Must include xc.h for all PICs when using xc8 compiler
+
+// PIC12F1840 Configuration Bit Settings:
+
+// CONFIG1
+#pragma config FOSC = INTOSC    // Oscillator Selection (INTOSC oscillator: I/O function on CLKIN pin)
+#pragma config WDTE = OFF       // Watchdog Timer Enable (WDT disabled)
+#pragma config PWRTE = OFF      // Power-up Timer Enable (PWRT disabled)
+#pragma config MCLRE = OFF      // MCLR Pin Function Select (MCLR/VPP pin function is digital input, RA3 = T1G)
+#pragma config CP = OFF         // Flash Program Memory Code Protection (Program memory code protection is disabled)
+#pragma config CPD = OFF        // Data Memory Code Protection (Data memory code protection is disabled)
+#pragma config BOREN = ON       // Brown-out Reset Enable (Brown-out Reset enabled)
+#pragma config CLKOUTEN = OFF   // Clock Out Enable (CLKOUT function is disabled. I/O or oscillator function on the CLKOUT pin)
+#pragma config IESO = OFF       // Internal/External Switchover (Internal/External Switchover mode is disabled)
+#pragma config FCMEN = OFF      // Fail-Safe Clock Monitor Enable (Fail-Safe Clock Monitor is disabled)
+// CONFIG2
+#pragma config WRT = OFF        // Flash Memory Self-Write Protection (Write protection off)
+#pragma config PLLEN = ON       // PLL Enable (4x PLL enabled)
+#pragma config STVREN = ON      // Stack Overflow/Underflow Reset Enable (Stack Overflow or Underflow will cause a Reset)
+#pragma config BORV = LO        // Brown-out Reset Voltage Selection (Brown-out Reset Voltage (Vbor), low trip point selected.)
+#pragma config DEBUG = OFF      // In-Circuit Debugger Mode (In-Circuit Debugger disabled, ICSPCLK and ICSPDAT are general purpose I/O pins)
+#pragma config LVP = OFF        // Low-Voltage Programming Enable (High-voltage on MCLR/VPP must be used for programming)
+
+ // Single line config setup can be used: #pragma config FOSC=INTOSC,etc,....
+
+#define _XTAL_FREQ 32000000      // Define clock frequency used by xc8 __delay(time) functions
+
+// Set the TM1637 module data and clock pins:
+#define trisConfiguration 0b00111100; // TM1637 RA4/5 pins are inputs, module pullups take high, RA2/3 signal inputs
+#define tm1637dio RA4                 // Set the i/o ports names for TM1637 data and clock here
+#define tm1637dioTrisBit 4            // This is the bit shift to set TRIS for GP4
+#define tm1637clk RA5
+#define tm1637clkTrisBit 5
+#define TM1637POWERUPMS 100           // Upper bound on the TM1637 module power up, the 100ms the original code
+                                      // allowed for modules with bus capacitors, see TM1637 Capacitor Removal
+                                      // Info.pdf. The TM1637 datasheet gives no power up time
+#define TM1637POLLUS 3200             // One ACK poll, start + 1 byte + stop = 100us + 2.8ms + 300us
+#define TM1637POWERUPPOLLS (TM1637POWERUPMS * 1000UL / TM1637POLLUS)
+#define OSCREADYMASK 0x41             // OSCSTAT PLLR (b6) = 4x PLL ready, HFIOFS (b0) = HFINTOSC stable
+
+// Measurement settings:
+#define TICKSPERUS 8                  // Timer1 ticks per us, Fosc/4 = 8MHz
+#define GATETICKS 800000UL            // Measurement window, 100ms in Timer1 ticks
+#define HIGHTIMEWINDOW 12             // High time phase ends on the first pulse after 12 x 8.192ms = 98ms..
+#define HIGHTIMEPULSES 1000           // ..or after this many pulses
+#define PRESCALEPERIODTICKS 400       // Capture every 16th edge if the mean period is below 50us, 20kHz
+#define NOSIGNALTIMEOUT 250           // Timer0 overflows, 250 x 8.192ms = 2.05s without an edge = no signal
+#define PHASEIDLE 0                   // Measurement phases, PHASEIDLE = measurement complete
+#define PHASEPERIOD 1
+#define PHASEHIGHTIME 2
+#define PHASEOVERRUN 3                // Capture ISR could not keep up with the input, period phase discarded
+#define MEASUREBUFFERSIZE 4           // Completed measurements buffered by the ISR, must be a power of 2
+#define MEASUREBUFFERMASK (MEASUREBUFFERSIZE - 1)
+#define SHOWFREQUENCY 0               // Display selectors for displayMeasure
+#define SHOWPERIOD 1
+#define SHOWDUTY 2
+#define DISPLAYOVERRANGE 0xFFFF       // Returned by formatRatio() if the value needs more than 4 digits
+#define DISPLAYDASH 10                // tm1637DisplayNumtoSeg[] index for '-', used to show overrange
+
+// Register setup values and bits:
+#define T1CONSETUP 0x01               // TMR1CS=00 Fosc/4 (b7..6), T1CKPS=00 1:1 (b5..4), TMR1ON (b0)
+#define T1GCONHIGHTIME 0xD0           // TMR1GE (b7), T1GPOL (b6) count while high, T1GSPM (b4), T1GSS=00 T1G pin
+#define T1GGOMASK 0x08                // T1GCON T1GGO/DONE (b3), arms single pulse acquisition
+#define T1GSELMASK 0x08               // APFCON T1GSEL (b3), T1G function on RA3
+#define CCPCAPTURERISING 0x05         // CCP1CON CCP1M=0101, capture every rising edge
+#define CCPCAPTURE16 0x07             // CCP1CON CCP1M=0111, capture every 16th rising edge
+#define OPTIONSETUP 0x87              // Pullups off (b7), Timer0 Fosc/4 (b5), prescaler 1:256 (b3..0)
+// PIR1/PIE1 bits:
+#define TMR1IFMASK 0x01
+#define CCP1IFMASK 0x04
+#define TMR1GIFMASK 0x80
+// INTCON bits:
+#define TMR0IFMASK 0x04
+#define TMR0IEMASK 0x20
+#define PEIEMASK 0x40
+#define GIEMASK 0x80
+
+typedef struct
+{
+    uint8_t phase;                    // PHASEPERIOD, PHASEHIGHTIME or PHASEOVERRUN
+    uint32_t ticks;                   // Timer1 ticks, PERIOD: spanning count edges, HIGHTIME: total high time
+    uint32_t count;                   // Rising edges or high pulses measured, 0 = no signal
+} measurement_t;
+
+//Variables:
+
+const uint8_t tm1637ByteSetData = 0x40;        // 0x40 [01000000] = Indicate command to display data
+const uint8_t tm1637ByteSetAddr = 0xC0;        // 0xC0 [11000000] = Start address write out all display bytes
+const uint8_t tm1637ByteSetOn = 0x88;          // 0x88 [10001000] = Display ON, plus brightness
+const uint8_t tm1637ByteSetOff = 0x80;         // 0x80 [10000000] = Display OFF
+const uint8_t tm1637MaxDigits = 4;
+const uint8_t tm1637RightDigit = tm1637MaxDigits - 1;
+                                               // Used to output the segment data for numbers 0..9, then '-':
+const uint8_t tm1637DisplayNumtoSeg[] = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f, 0x40};
+uint8_t tm1637Brightness = 5;                           // Range 0 to 7
+uint8_t tm1637Data[] = {0, 0, 0, 0}; //Digit numeric data to display,array elements are for digits 0..3
+uint8_t decimalPointPos = 99;        //Flag for decimal point (digits counted from left),if > MaxDigits dp off
+uint8_t zeroBlanking = 1;            //If set true blanks leading zeros
+uint8_t rangeFlag = 0;               //If set lights the rightmost decimal point, shows kHz or ms range
+uint8_t displayMeasure = SHOWFREQUENCY;  // Selects the displayed value, SHOWFREQUENCY/SHOWPERIOD/SHOWDUTY
+
+//Measurement variables, shared with the ISR:
+volatile uint8_t measurePhase = PHASEIDLE;
+volatile uint16_t tmr1Overflows = 0;           // Timer1 count bits 31..16
+volatile uint8_t timeoutTicks = 0;             // Timer0 overflows since the last edge or pulse
+volatile uint8_t phaseTicks = 0;               // Timer0 overflows since the phase started
+volatile uint8_t captureStarted = 0;           // Set once the first edge of the window is captured
+volatile uint32_t captureFirst = 0;            // Timer1 count at the first captured edge
+volatile uint32_t captureEdges = 0;            // Rising edges since the first captured edge
+uint8_t capturePrescale = 1;                   // Rising edges per capture, 1 or 16
+volatile uint16_t highPulses = 0;
+measurement_t measureBuffer[MEASUREBUFFERSIZE];
+volatile uint8_t measureHead = 0;              // Next free slot, written by ISR
+volatile uint8_t measureTail = 0;              // Next measurement to read, written by main()
+
+//Function prototypes:
+void __interrupt() ISR(void);  // Note XC8 interrupt function setup syntax using __interrupt() + myisr()
+void initialise(void);
+void startPeriodPhase(void);                   // Starts CCP1 capture of rising edges
+void startHighTimePhase(void);                 // Starts Timer1 gated high time measurement
+void measurePut(uint8_t phase, uint32_t ticks, uint32_t count);   // ISR only, ends the phase
+uint8_t measureGet(measurement_t *result);     // Gets the next completed measurement, 0 if none
+uint16_t formatRatio(uint32_t numerator, uint32_t denominator, uint8_t scale);
+void showMeasurement(uint32_t periodTicks, uint32_t periodEdges, uint32_t highTicks, uint32_t pulses);
+void showOverrange(void);                      // Sets tm1637Data to '----'
+void tm1637StartCondition(void);
+void tm1637StopCondition(void);
+uint8_t tm1637ByteWrite(uint8_t bWrite);
+uint8_t tm1637WaitReady(void);        // Polls the module for an ACK until it has powered up
+void tm1637UpdateDisplay(void);
+void tm1637DisplayOn(void);
+void tm1637DisplayOff(void);
+uint8_t getDigits(uint16_t number);   //Extracts decimal digits from integer, populates tm1637Data array
+
+
+void main(void)
+{
+  measurement_t result;
+  uint32_t periodTicks = 0;     // Last PERIOD phase result, kept to give the duty cycle
+  uint32_t periodEdges = 0;
+  initialise();             // Will initialise the 12F1840 with 32MHz clock, TRIS configured,ADC disabled
+  getDigits(0);
+  tm1637WaitReady();             // Waits only until the module ACKs, at most TM1637POWERUPMS
+  tm1637UpdateDisplay();
+  startPeriodPhase();
+  while(1)
+    {
+      if (measureGet(&result))
+      {
+        if (result.phase == PHASEOVERRUN)
+        {
+          if (capturePrescale == 1)
+              capturePrescale = 16;          // Retry at once capturing every 16th edge
+          else
+          {
+              showOverrange();               // Above the maximum input frequency
+              tm1637UpdateDisplay();
+          }
+          startPeriodPhase();
+        }
+        else if (result.phase == PHASEPERIOD)
+        {
+          periodTicks = result.ticks;
+          periodEdges = result.count;
+          if (periodEdges && (periodTicks / periodEdges) < PRESCALEPERIODTICKS)
+              capturePrescale = 16;          // Fast signal, capture less often for the next period phase
+          else
+              capturePrescale = 1;
+          startHighTimePhase();
+        }
+        else
+        {
+          startPeriodPhase();                // Measures while the display is written
+          showMeasurement(periodTicks, periodEdges, result.ticks, result.count);
+          tm1637UpdateDisplay();
+        }
+      }
+    }
+}
+
+//***************************************************************************************
+// Interrupt service routine, capture is checked first as its latency sets the maximum
+// input frequency. Timer1 overflow is handled before the gate so the count is up to date.
+//***************************************************************************************
+
+void ISR(void)
+{
+    uint8_t pending = PIR1 & PIE1;    // Enabled sources only, flags are also set for disabled sources
+
+    if (pending & CCP1IFMASK)         // CCP1 capture of a rising edge
+    {
+        uint16_t overflows = tmr1Overflows;
+        uint32_t stamp;
+        PIR1 &= ~CCP1IFMASK;
+        if ((PIR1 & TMR1IFMASK) && !(CCPR1H & 0x80))
+            overflows ++;             // Timer1 rolled over before this capture but not yet counted
+        stamp = ((uint32_t)overflows << 16) | ((uint16_t)CCPR1H << 8) | CCPR1L;
+        timeoutTicks = 0;
+        if (!captureStarted)
+        {
+            captureFirst = stamp;
+            captureEdges = 0;
+            captureStarted = 1;
+        }
+        else
+        {
+            captureEdges += capturePrescale;
+            if ((stamp - captureFirst) >= GATETICKS)
+                measurePut(PHASEPERIOD, stamp - captureFirst, captureEdges);
+        }
+        if ((measurePhase == PHASEPERIOD) && (PIR1 & CCP1IFMASK))
+            measurePut(PHASEOVERRUN, 0, 0);   // Next capture already done, edges would be lost
+    }
+    if (pending & TMR1IFMASK)         // Timer1 overflow, every 8.192ms of counting
+    {
+        PIR1 &= ~TMR1IFMASK;
+        tmr1Overflows ++;
+    }
+    if (pending & TMR1GIFMASK)        // Single pulse done, Timer1 is stopped by the gate
+    {
+        uint32_t highTicks;
+        PIR1 &= ~TMR1GIFMASK;
+        highPulses ++;
+        timeoutTicks = 0;
+        highTicks = ((uint32_t)tmr1Overflows << 16) | ((uint16_t)TMR1H << 8) | TMR1L;
+        if (phaseTicks >= HIGHTIMEWINDOW || highPulses >= HIGHTIMEPULSES)
+            measurePut(PHASEHIGHTIME, highTicks, highPulses);
+        else
+            T1GCON |= T1GGOMASK;      // Rearm for the next pulse
+    }
+    if (INTCON & TMR0IFMASK)          // Timer0 every 8.192ms, no signal timeout
+    {
+        INTCON &= ~TMR0IFMASK;
+        if (phaseTicks < 255)
+            phaseTicks ++;
+        if (measurePhase != PHASEIDLE && ++timeoutTicks >= NOSIGNALTIMEOUT)
+            measurePut(measurePhase, 0, 0);
+    }
+}
+
+/*************************************************************************************************
+ measurePut() is called from the ISR only. Stops the current phase and adds the measurement to the
+ buffer, a measurement is dropped if the buffer is full.
+ ************************************************************************************************/
+void measurePut(uint8_t phase, uint32_t ticks, uint32_t count)
+{
+    uint8_t next = (measureHead + 1) & MEASUREBUFFERMASK;
+    PIE1 &= ~(CCP1IFMASK | TMR1GIFMASK | TMR1IFMASK);
+    measurePhase = PHASEIDLE;
+    if (next != measureTail)
+    {
+        measureBuffer[measureHead].phase = phase;
+        measureBuffer[measureHead].ticks = ticks;
+        measureBuffer[measureHead].count = count;
+        measureHead = next;
+    }
+}
+
+uint8_t measureGet(measurement_t *result)
+{
+    if (measureTail == measureHead)
+        return 0;
+    *result = measureBuffer[measureTail];
+    measureTail = (measureTail + 1) & MEASUREBUFFERMASK;
+    return 1;
+}
+
+/*************************************************************************************************
+ startPeriodPhase() sets Timer1 free running from zero and CCP1 capturing rising edges, the
+ capture prescale is set from the previous period measurement. startHighTimePhase() sets Timer1
+ to count only while T1G is high and arms the first single pulse.
+ ************************************************************************************************/
+void startPeriodPhase(void)
+{
+    T1CON = 0;                        // Timer1 off while setting up
+    T1GCON = 0;                       // Gate off, Timer1 free running
+    TMR1H = 0;
+    TMR1L = 0;
+    CCP1CON = 0;                      // CCP1 off before changing capture mode, avoids a false capture
+    CCP1CON = (capturePrescale == 16) ? CCPCAPTURE16 : CCPCAPTURERISING;
+    tmr1Overflows = 0;
+    captureStarted = 0;
+    timeoutTicks = 0;
+    measurePhase = PHASEPERIOD;
+    PIR1 &= ~(CCP1IFMASK | TMR1IFMASK);
+    T1CON = T1CONSETUP;
+    PIE1 |= CCP1IFMASK | TMR1IFMASK;
+}
+
+void startHighTimePhase(void)
+{
+    T1CON = 0;
+    CCP1CON = 0;                      // Capture off
+    T1GCON = T1GCONHIGHTIME;
+    TMR1H = 0;
+    TMR1L = 0;
+    tmr1Overflows = 0;
+    highPulses = 0;
+    timeoutTicks = 0;
+    phaseTicks = 0;
+    measurePhase = PHASEHIGHTIME;
+    PIR1 &= ~(TMR1GIFMASK | TMR1IFMASK);
+    T1CON = T1CONSETUP;
+    T1GCON |= T1GGOMASK;              // Count from the next rising edge of T1G to the falling edge
+    PIE1 |= TMR1GIFMASK | TMR1IFMASK;
+}
+
+/*************************************************************************************************
+ showMeasurement() auto-ranges the selected measurement into tm1637Data for display:
+   Frequency  0.500 .. 9999 Hz, then 10.00 .. 9999 kHz with the rightmost dp lit
+   Period     0.125 .. 9999 us, then 10.00 .. 9999 ms with the rightmost dp lit
+   Duty cycle 0.00 .. 100.0 %
+ No signal displays 0, or a duty cycle of 0 or 100% for an input held low or high. showOverrange()
+ displays '----' for a value that needs more than 4 digits or an input too fast to capture.
+ ************************************************************************************************/
+void showMeasurement(uint32_t periodTicks, uint32_t periodEdges, uint32_t highTicks, uint32_t pulses)
+{
+    uint16_t displayedInt = 0;
+    rangeFlag = 0;
+    decimalPointPos = 99;
+    if (displayMeasure == SHOWDUTY)
+    {
+        if (pulses && periodEdges)             // Duty = high ticks / (pulses x mean period)
+            displayedInt = formatRatio(highTicks, (pulses * periodTicks) / periodEdges, 2);
+        else if (RA3)                          // No pulses, input held high
+            displayedInt = formatRatio(1, 1, 2);
+    }
+    else if (periodEdges)
+    {
+        if (displayMeasure == SHOWFREQUENCY)   // f = edges x 8MHz / ticks
+        {
+            displayedInt = formatRatio(periodEdges * TICKSPERUS, periodTicks, 6);
+            if (displayedInt == DISPLAYOVERRANGE)
+            {
+                displayedInt = formatRatio(periodEdges * TICKSPERUS, periodTicks, 3);
+                rangeFlag = 1;
+            }
+        }
+        else                                   // Period = ticks / (edges x 8) us
+        {
+            displayedInt = formatRatio(periodTicks, periodEdges * TICKSPERUS, 0);
+            if (displayedInt == DISPLAYOVERRANGE)
+            {
+                displayedInt = formatRatio(periodTicks, periodEdges * TICKSPERUS * 1000UL, 0);
+                rangeFlag = 1;
+            }
+        }
+    }
+    if (displayedInt == DISPLAYOVERRANGE)
+        showOverrange();
+    else
+        getDigits(displayedInt);
+}
+
+void showOverrange(void)
+{
+    for (uint8_t ctr = 0; ctr < tm1637MaxDigits; ctr++)
+        tm1637Data[ctr] = DISPLAYDASH;
+    decimalPointPos = 99;
+    rangeFlag = 0;
+}
+
+/*************************************************************************************************
+ formatRatio() returns numerator / denominator x 10^scale to 4 significant digits for the display
+ and sets decimalPointPos, or returns DISPLAYOVERRANGE if more than 4 digits are needed. Long division,
+ one decimal digit at a time, so only 32 bit integer maths is needed, denominator must be < 400 million.
+ ************************************************************************************************/
+uint16_t formatRatio(uint32_t numerator, uint32_t denominator, uint8_t scale)
+{
+    uint32_t value = numerator / denominator;
+    uint32_t remainder = numerator % denominator;
+    uint8_t places = 0;                        // Decimal places of numerator / denominator in value
+    while (value < 1000 && places < (uint8_t)(scale + 3))
+    {
+        remainder *= 10;
+        value = value * 10 + remainder / denominator;
+        remainder %= denominator;
+        places ++;
+    }
+    if (value > 9999 || places < scale)
+        return DISPLAYOVERRANGE;
+    decimalPointPos = (places > scale) ? (uint8_t)(tm1637RightDigit - (places - scale)) : 99;
+    return (uint16_t)value;
+}
+
+/*********************************************************************************************
+ tm1637UpdateDisplay()
+ Publish the tm1637Data array to the display
+*********************************************************************************************/
+void tm1637UpdateDisplay()
+{
+    uint8_t tm1637DigitSegs = 0;
+    uint8_t ctr;
+    uint8_t stopBlanking = !zeroBlanking;            // Allow blanking of leading zeros if flag set
+
+    // Write 0x40 [01000000] to indicate command to display data - [Write data to display register]:
+    tm1637StartCondition();
+    tm1637ByteWrite(tm1637ByteSetData);
+    tm1637StopCondition();
+
+    // Specify the display address 0xC0 [11000000] then write out all 4 bytes:
+    tm1637StartCondition();
+    tm1637ByteWrite(tm1637ByteSetAddr);
+    for (ctr = 0; ctr < tm1637MaxDigits; ctr ++)
+    {
+        tm1637DigitSegs = tm1637DisplayNumtoSeg[tm1637Data[ctr]];
+        if (!stopBlanking && (tm1637Data[ctr]==0) && (ctr < decimalPointPos))  // Blank leading zeros if stop
+            {                                                                  // blanking flag not set, 0.nnn kept
+               if (ctr < tm1637RightDigit)          // Never blank the rightmost digit
+                  tm1637DigitSegs = 0;              // Segments set 0x00 gives blanked display numeral
+            }
+        else
+        {
+           stopBlanking = 1;                    // Stop blanking if have reached a non-zero digit
+           if (ctr==decimalPointPos)            // Flag for presence of decimal point, digits 0..3
+           {                                    // No dp display if decimalPointPos is set > Maxdigits
+               tm1637DigitSegs |= 0b10000000;   // High bit of segment data is decimal point, set to display
+           }
+        }
+        if (rangeFlag && (ctr == tm1637RightDigit))
+            tm1637DigitSegs |= 0b10000000;      // Rightmost decimal point shows the kHz or ms range
+        tm1637ByteWrite(tm1637DigitSegs);       // Finally write out the segment data for each digit
+    }
+    tm1637StopCondition();
+
+    // Write 0x80 [10001000] - Display ON, plus brightness
+    tm1637StartCondition();
+    tm1637ByteWrite((tm1637ByteSetOn + tm1637Brightness));
+    tm1637StopCondition();
+}
+
+
+/*********************************************************************************************
+ tm1637DisplayOn()
+ Send display on command
+*********************************************************************************************/
+void tm1637DisplayOn(void)
+{
+    tm1637StartCondition();
+    tm1637ByteWrite((tm1637ByteSetOn + tm1637Brightness));
+    tm1637StopCondition();
+}
+
+
+/*********************************************************************************************
+ tm1637DisplayOff()
+ Send display off command
+*********************************************************************************************/
+void tm1637DisplayOff(void)
+{
+    tm1637StartCondition();
+    tm1637ByteWrite(tm1637ByteSetOff);
+    tm1637StopCondition();
+}
+
+/*********************************************************************************************
+ tm1637StartCondition()
+ Send the start condition
+*********************************************************************************************/
+void tm1637StartCondition(void)
+{
+    TRISA &= ~(1<<tm1637dioTrisBit);   //Clear data tris bit
+    tm1637dio = 0;                     //Data output set low
+    __delay_us(100);
+}
+
+
+/*********************************************************************************************
+ tm1637StopCondition()
+ Send the stop condition
+*********************************************************************************************/
+void tm1637StopCondition()
+{
+    TRISA &= ~(1<<tm1637dioTrisBit);    // Clear data tris bit
+    tm1637dio = 0;                      // Data low
+    __delay_us(100);
+    TRISA |= 1<<tm1637clkTrisBit;       // Set tris to release clk
+    __delay_us(100);
+    // Release data
+    TRISA |= 1<<tm1637dioTrisBit;       // Set tris to release data
+    __delay_us(100);
+}
+
+
+/*********************************************************************************************
+ tm1637WaitReady()
+ Polls the module with the display data command until it ACKs, ie. has powered up, returns
+ 1 if it did. Gives up after TM1637POWERUPPOLLS, ~100ms, so a missing module does not hang
+*********************************************************************************************/
+uint8_t tm1637WaitReady(void)
+{
+    for (uint8_t poll = 0; poll < TM1637POWERUPPOLLS; poll++)
+    {
+        tm1637StartCondition();
+        uint8_t ack = tm1637ByteWrite(tm1637ByteSetData);
+        tm1637StopCondition();
+        if (ack)
+            return 1;
+    }
+    return 0;
+}
+
+/*********************************************************************************************
+ tm1637ByteWrite(char bWrite)
+ Write one byte, returns 1 if the module acknowledged the byte
+*********************************************************************************************/
+uint8_t tm1637ByteWrite(uint8_t bWrite) {
+    for (uint8_t i = 0; i < 8; i++) {
+        // Clock low
+        TRISA &= ~(1<<tm1637clkTrisBit);       // Clear clk tris bit
+        tm1637clk = 0;
+        __delay_us(100);
+
+        // Test bit of byte, data high or low:
+        if ((bWrite & 0x01) > 0) {
+            TRISA |= 1<<tm1637dioTrisBit;       // Set data tris
+        } else {
+            TRISA &= ~(1<<tm1637dioTrisBit);    // Clear data tris bit
+            tm1637dio = 0;
+        }
+        __delay_us(100);
+
+        // Shift bits to the left:
+        bWrite = (bWrite >> 1);
+        TRISA |= 1<<tm1637clkTrisBit;           // Set tris so clk goes high
+        __delay_us(100);
+    }
+
+    // Wait for ack, send clock low:
+    TRISA &= ~(1<<tm1637clkTrisBit);       // Clear clk tris bit
+    tm1637clk = 0;
+    TRISA |= 1<<tm1637dioTrisBit;          // Set data tris, makes input
+    tm1637dio = 0;
+    __delay_us(100);
+
+    TRISA |= 1<<tm1637clkTrisBit;          // Set tris so clk goes high
+    __delay_us(100);
+    uint8_t tm1637ack = tm1637dio;
+    if (!tm1637ack)
+    {
+        TRISA &= ~(1<<tm1637dioTrisBit);   // Clear data tris bit
+        tm1637dio = 0;
+    }
+    __delay_us(100);
+    TRISA &= ~(1<<tm1637clkTrisBit);       // Clear clk tris bit, set clock low
+    tm1637clk = 0;
+    __delay_us(100);
+
+    return !tm1637ack;                     // Returns 1 if the byte was acknowledged
+}
+
+
+/*********************************************************************************************
+  Function called once only to initialise variables and
+  setup the PIC registers
+*********************************************************************************************/
+void initialise()
+{
+    OSCCON = 0b11110000;     // SPLLEN (b7) set = 4x PLL enable (nb config setting will override)
+    PORTA = 0;               // OSCCON IRCF=1110 (b6..3), gives 8MHz clock, x4 with PLL = 32 MHz. SCS=00(1..0)
+    TRISA = trisConfiguration;      // Clear the PORTA outputs then set TRIS
+    ANSELA = 0;                     // Configure A/D inputs as digital I/O
+    CM1CON0 = 7;                    // Comparator off
+    APFCON |= T1GSELMASK;           // T1G on RA3, RA4 is the TM1637 DIO
+    OPTION_REG = OPTIONSETUP;       // Timer0 runs for the no signal timeout, 8.192ms overflow
+    while ((OSCSTAT & OSCREADYMASK) != OSCREADYMASK);  // Wait for HFINTOSC stable and PLL lock, 2ms max
+    INTCON |= TMR0IEMASK | PEIEMASK | GIEMASK;       // Timer0, peripheral and global interrupts on
+}
+
+
+/*************************************************************************************************
+ getDigits extracts decimal digit numbers from an integer for the display, note max displayed value is
+ 9999 for 4 digit display, truncation of larger numbers. Larger displays: note maximum 65K as coded with
+ 16 bit parameter - probable need to declare number as uint32_t if coding for a 6 digit display
+ ************************************************************************************************/
+
+uint8_t getDigits(uint16_t number)
+{
+    int8_t ctr = (tm1637RightDigit);            // Start processing for the rightmost displayed digit
+    for (uint8_t ctr2 = 0; ctr2 < tm1637MaxDigits; ctr2++)
+    {
+        tm1637Data[ctr2]=0;      //Initialise the display data array with 0s
+    }
+    while(number > 0)            //Do if number greater than 0, ie. until all number's digits processed
+    {
+        if (ctr >= 0)
+        {
+           uint16_t modulus = number % 10;      // Split last digit from number
+           tm1637Data[ctr] = (uint8_t)modulus;  // Update display character array
+           number = number / 10;                // Divide number by 10
+           ctr --;                              // Decrement digit counter to process number from right to left
+        }
+        else
+        {
+           number = 0;                          // Stop processing if have exceeded display's no of digits
+        }
+    }
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,431 @@
+// ---------------------------------------------------------------------
+// Lookup table generator for linearising nonlinear sensors read by the ADC,
+// used by lutLinearise() in PIC12F1840ADC.c. Reads a sensor curve description
+// and writes a const table header so the PIC needs no float or 32 bit maths.
+// Standard C, build with eg.:
+//     cc -O2 -o lutGenerator host/lutGenerator.c -lm
+//
+// Usage:
+//     lutGenerator curve.txt > sensorLUT.h    Runs the check below, report on stderr, then writes
+//                                             the table header, or nothing and exit status 1 if
+//                                             the table is over tolerance
+//     lutGenerator --check curve.txt          Compares the integer interpolation, done exactly
+//                                             as on the PIC, with the exact curve clamped to
+//                                             min..max at every ADC count, exit status 1 if over
+//                                             tolerance
+//
+// Curve description, one key=value per line, # starts a comment:
+//     type=ntc          ntc: thermistor beta model, R = r25 x exp(beta x (1/T - 1/298.15))
+//                       ldr: light dependent resistor, R = r10 x (lux/10)^-gamma
+//     r25=10000         ntc resistance at 25C, ohms
+//     beta=3950         ntc beta, K
+//     r10=10000         ldr resistance at 10 lux, ohms
+//     gamma=0.7         ldr slope, log(R) per log(lux)
+//     rfixed=10000      Fixed divider resistor, ohms
+//     sensor=low        low: sensor from ADC pin to 0V, fixed resistor to supply, high: the reverse
+//     vsupply=5000      Divider supply, mV
+//     vref=4096         ADC positive reference, mV
+//     units=0.1         Table value LSB in engineering units, eg. 0.1 = tenths of a degree C
+//     min=0             Output clamp, in table LSBs. Both min and max must fit the 4 digit display,
+//                       -999..9999, negative values show a '-'
+//     max=1000
+//     step=32           ADC counts per table entry, a power of 2, 4..256, table has 1024/step + 1
+//                       entries. The PIC indexes the table with a uint8_t, so 257 entries at most
+//     decimals=1        Decimal places for the display, ie. the number of digits after the dp
+//     tolerance=5       --check fails if the interpolation error exceeds this, table LSBs
+// -----------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define ADCCOUNTS 1024
+#define MAXENTRIES (ADCCOUNTS + 1)
+#define KELVIN0C 273.15
+#define KELVIN25C 298.15
+
+typedef struct
+{
+    char type[64];
+    double r25;
+    double beta;
+    double r10;
+    double gamma;
+    double rfixed;
+    int sensorLow;
+    double vsupply;
+    double vref;
+    double units;
+    long min;
+    long max;
+    int step;
+    int decimals;
+    long tolerance;
+} curve_t;
+
+static int readCurve(const char *fileName, curve_t *curve)
+{
+    FILE *file = fopen(fileName, "r");
+    char line[256];
+    int lineNumber = 0;
+
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open %s\n", fileName);
+        return 0;
+    }
+    strcpy(curve->type, "ntc");
+    curve->r25 = 10000;
+    curve->beta = 3950;
+    curve->r10 = 10000;
+    curve->gamma = 0.7;
+    curve->rfixed = 10000;
+    curve->sensorLow = 1;
+    curve->vsupply = 5000;
+    curve->vref = 4096;
+    curve->units = 0.1;
+    curve->min = 0;
+    curve->max = 1000;
+    curve->step = 32;
+    curve->decimals = 1;
+    curve->tolerance = 5;
+    while (fgets(line, sizeof(line), file))
+    {
+        char key[32];
+        char value[64];
+        char *comment = strchr(line, '#');
+        lineNumber ++;
+        if (comment)
+            *comment = 0;
+        if (sscanf(line, " %31[^= \t] = %63s", key, value) != 2)
+            continue;
+        if (!strcmp(key, "type"))
+            snprintf(curve->type, sizeof(curve->type), "%s", value);
+        else if (!strcmp(key, "r25"))
+            curve->r25 = atof(value);
+        else if (!strcmp(key, "beta"))
+            curve->beta = atof(value);
+        else if (!strcmp(key, "r10"))
+            curve->r10 = atof(value);
+        else if (!strcmp(key, "gamma"))
+            curve->gamma = atof(value);
+        else if (!strcmp(key, "rfixed"))
+            curve->rfixed = atof(value);
+        else if (!strcmp(key, "sensor"))
+            curve->sensorLow = strcmp(value, "high") != 0;
+        else if (!strcmp(key, "vsupply"))
+            curve->vsupply = atof(value);
+        else if (!strcmp(key, "vref"))
+            curve->vref = atof(value);
+        else if (!strcmp(key, "units"))
+            curve->units = atof(value);
+        else if (!strcmp(key, "min"))
+            curve->min = atol(value);
+        else if (!strcmp(key, "max"))
+            curve->max = atol(value);
+        else if (!strcmp(key, "step"))
+            curve->step = atoi(value);
+        else if (!strcmp(key, "decimals"))
+            curve->decimals = atoi(value);
+        else if (!strcmp(key, "tolerance"))
+            curve->tolerance = atol(value);
+        else
+        {
+            fprintf(stderr, "%s:%d: unknown key %s\n", fileName, lineNumber, key);
+            fclose(file);
+            return 0;
+        }
+    }
+    fclose(file);
+    if (strcmp(curve->type, "ntc") && strcmp(curve->type, "ldr"))
+    {
+        fprintf(stderr, "%s: type must be ntc or ldr\n", fileName);
+        return 0;
+    }
+    if (curve->step < 4 || curve->step > 256 || (curve->step & (curve->step - 1)))
+    {
+        fprintf(stderr, "%s: step must be a power of 2, 4..256\n", fileName);
+        return 0;
+    }
+    if (curve->min < -999 || curve->max > 9999 || curve->min >= curve->max || curve->units <= 0)
+    {
+        fprintf(stderr, "%s: min/max must fit the 4 digit display, -999..9999, with min < max, units > 0\n",
+                fileName);
+        return 0;
+    }
+    return 1;
+}
+
+// Exact sensor value in table LSBs for a (possibly fractional) ADC count, unclamped.
+// An ADC count c is taken as the middle of its input range, (c + 0.5) x vref / 1024:
+static double exactValue(const curve_t *curve, double counts)
+{
+    double vout = (counts + 0.5) * curve->vref / ADCCOUNTS;
+    double resistance;
+    double value;
+
+    if (vout >= curve->vsupply)
+        return curve->sensorLow ? HUGE_VAL : -HUGE_VAL;
+    if (curve->sensorLow)
+        resistance = curve->rfixed * vout / (curve->vsupply - vout);
+    else
+        resistance = curve->rfixed * (curve->vsupply - vout) / vout;
+    if (!strcmp(curve->type, "ntc"))
+    {
+        double kelvin = 1.0 / (1.0 / KELVIN25C + log(resistance / curve->r25) / curve->beta);
+        value = kelvin - KELVIN0C;
+    }
+    else
+        value = 10.0 * pow(resistance / curve->r10, -1.0 / curve->gamma);
+    return value / curve->units;
+}
+
+static long clampValue(const curve_t *curve, double value)
+{
+    if (value != value || value <= curve->min)      // NaN or below range
+        return curve->min;
+    if (value >= curve->max)
+        return curve->max;
+    return lround(value);
+}
+
+static int stepShift(int step)
+{
+    int shift = 0;
+    while ((1 << shift) < step)
+        shift ++;
+    return shift;
+}
+
+static int segmentInRange(const curve_t *curve, int segment)   // Any count of the segment within min..max
+{
+    if (segment < 0 || segment >= ADCCOUNTS / curve->step)
+        return 0;
+    for (int counts = segment * curve->step; counts < (segment + 1) * curve->step; counts++)
+    {
+        double value = exactValue(curve, counts);
+        if (value >= curve->min && value <= curve->max)
+            return 1;
+    }
+    return 0;
+}
+
+// Table entry i starts as the exact value at ADC count i x step, the last entry is at count 1024
+// which the ADC never returns, so it only sets the slope of the last segment. Entries are clamped
+// to min..max unless a segment either side reaches into the range, where the unclamped value keeps
+// the interpolation on the curve up to the limit, lutLinearise() clamps its result.
+// A curved sensor gives an interpolation error of one sign across each segment, the chord sags
+// from the curve. Each unclamped entry is then moved by half the mean sag of the segments either
+// side, which centres the error and about halves the maximum error of a table sampled on the curve:
+static double segmentError(const curve_t *curve, const double *node, int segment, double *errorMin)
+{
+    double errorMax = -HUGE_VAL;
+    *errorMin = HUGE_VAL;
+    if (segment < 0 || segment >= ADCCOUNTS / curve->step)
+        return errorMax;
+    for (int counts = segment * curve->step; counts < (segment + 1) * curve->step; counts++)
+    {
+        double exact = exactValue(curve, counts);
+        double fraction = (double)(counts - segment * curve->step) / curve->step;
+        double error = node[segment] + (node[segment + 1] - node[segment]) * fraction - exact;
+        if (!(exact >= curve->min && exact <= curve->max))
+            continue;
+        if (error > errorMax)
+            errorMax = error;
+        if (error < *errorMin)
+            *errorMin = error;
+    }
+    return errorMax;
+}
+
+static int buildTable(const curve_t *curve, int16_t *table)
+{
+    int entries = ADCCOUNTS / curve->step + 1;
+    int shift = stepShift(curve->step);
+    double node[MAXENTRIES];
+    int fixed[MAXENTRIES];
+    double sag[MAXENTRIES];
+
+    for (int i = 0; i < entries; i++)
+    {
+        double value = exactValue(curve, (double)(i * curve->step));
+        fixed[i] = !segmentInRange(curve, i - 1) && !segmentInRange(curve, i);
+        if (fixed[i])
+            node[i] = (double)clampValue(curve, value);
+        else if (value != value || value < -32768 || value > 32767)
+        {
+            fprintf(stderr, "Entry %d value %g outside int16, use a smaller step or units\n", i, value);
+            return 0;
+        }
+        else
+            node[i] = value;
+    }
+    for (int i = 0; i < entries - 1; i++)
+    {
+        double errorMin;
+        double errorMax = segmentError(curve, node, i, &errorMin);
+        sag[i] = 0;
+        if (errorMax >= errorMin)                      // Segment has counts in range
+            sag[i] = (errorMax > -errorMin) ? errorMax : errorMin;
+    }
+    for (int i = 0; i < entries; i++)
+    {
+        double lowSag = i > 0 ? sag[i - 1] : 0;
+        double highSag = i < entries - 1 ? sag[i] : 0;
+        int sides = (i > 0 && lowSag != 0) + (i < entries - 1 && highSag != 0);
+        if (!fixed[i] && sides)
+            node[i] -= 0.5 * (lowSag + highSag) / sides;
+    }
+    for (int i = 0; i < entries; i++)
+    {
+        if (node[i] < -32768 || node[i] > 32767)
+        {
+            fprintf(stderr, "Entry %d value %g outside int16, use a smaller step or units\n", i, node[i]);
+            return 0;
+        }
+        table[i] = (int16_t)lround(node[i]);
+    }
+    for (int i = 0; i + 1 < entries; i++)           // The PIC multiply is 16 bit unsigned
+    {
+        long delta = labs((long)table[i + 1] - table[i]);
+        if (delta * (curve->step - 1) + (1L << (shift - 1)) > 65535)
+        {
+            fprintf(stderr, "Segment %d change %ld too large for a 16 bit interpolation, use a smaller step\n",
+                    i, delta);
+            return 0;
+        }
+    }
+    return entries;
+}
+
+// Mirror of lutLinearise() in PIC12F1840ADC.c, same integer operations:
+static int16_t lutLinearise(const curve_t *curve, const int16_t *table, int shift, uint16_t counts)
+{
+    uint8_t index = (uint8_t)(counts >> shift);
+    uint8_t fraction = (uint8_t)(counts & ((1 << shift) - 1));
+    int16_t base = table[index];
+    int16_t delta = (int16_t)(table[index + 1] - base);
+    uint16_t magnitude = (uint16_t)(delta < 0 ? -delta : delta);
+    uint16_t product = 0;
+    for (int bit = 0; bit < shift; bit++)
+    {
+        if (fraction & 0x01)
+            product = (uint16_t)(product + magnitude);
+        fraction >>= 1;
+        magnitude = (uint16_t)(magnitude << 1);
+    }
+    product = (uint16_t)((product + (1 << (shift - 1))) >> shift);
+    base = (int16_t)(delta < 0 ? base - (int16_t)product : base + (int16_t)product);
+    if (base < curve->min)
+        return (int16_t)curve->min;
+    if (base > curve->max)
+        return (int16_t)curve->max;
+    return base;
+}
+
+static void writeDefine(const char *name, long value, const char *comment)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "#define %s %ld", name, value);
+    if (comment)
+        printf("%-39s// %s\n", text, comment);
+    else
+        printf("%s\n", text);
+}
+
+static void writeHeader(const char *fileName, const curve_t *curve, const int16_t *table, int entries)
+{
+    int shift = stepShift(curve->step);
+    printf("// Generated by host/lutGenerator.c from %s, do not edit, regenerate with:\n", fileName);
+    printf("//     lutGenerator %s > sensorLUT.h\n", fileName);
+    if (!strcmp(curve->type, "ntc"))
+        printf("// NTC thermistor, R25 = %.0f, beta = %.0f", curve->r25, curve->beta);
+    else
+        printf("// LDR, R10lux = %.0f, gamma = %.2f", curve->r10, curve->gamma);
+    printf(", %s side of a divider with %.0f ohms, supply %.0fmV, ADC Vref %.0fmV.\n",
+           curve->sensorLow ? "low" : "high", curve->rfixed, curve->vsupply, curve->vref);
+    printf("// Table values are in units of %g, clamped to %ld..%ld.\n\n", curve->units, curve->min, curve->max);
+    writeDefine("SENSORLUTSHIFT", shift, "ADC counts per table entry = 1 << SENSORLUTSHIFT");
+    writeDefine("SENSORLUTSIZE", entries, "Entries, 1024 / step + 1");
+    writeDefine("SENSORDECIMALS", curve->decimals, "Digits after the decimal point when displayed");
+    writeDefine("SENSORMIN", curve->min, "Output clamp, table units");
+    writeDefine("SENSORMAX", curve->max, NULL);
+    printf("\n");
+    printf("const int16_t sensorLUT[SENSORLUTSIZE] = {");
+    for (int i = 0; i < entries; i++)
+    {
+        printf("%s%d", i == 0 ? "\n    " : i % 11 == 0 ? ",\n    " : ", ", table[i]);
+    }
+    printf("};\n");
+}
+
+// Checks every ADC count against the exact value clamped to min..max, as the PIC clamps its
+// output, so the clamped ends must hold the limit too. Writes the report to out:
+static int runCheck(FILE *out, const curve_t *curve, const int16_t *table)
+{
+    int shift = stepShift(curve->step);
+    double maxError = 0;
+    double sumSquares = 0;
+    int worstCount = 0;
+    int clamped = 0;
+
+    for (int counts = 0; counts < ADCCOUNTS; counts++)
+    {
+        double exact = exactValue(curve, counts);
+        if (!(exact >= curve->min))    // Also catches NaN
+        {
+            exact = curve->min;
+            clamped ++;
+        }
+        else if (exact > curve->max)
+        {
+            exact = curve->max;
+            clamped ++;
+        }
+        double error = lutLinearise(curve, table, shift, (uint16_t)counts) - exact;
+        if (fabs(error) > fabs(maxError))
+        {
+            maxError = error;
+            worstCount = counts;
+        }
+        sumSquares += error * error;
+    }
+    fprintf(out, "Checked ADC counts 0..%d, %d of them against the min/max clamp\n", ADCCOUNTS - 1, clamped);
+    fprintf(out, "Max error   %+.2f LSB = %+.4g units, at ADC count %d\n", maxError, maxError * curve->units,
+            worstCount);
+    fprintf(out, "RMS error   %.2f LSB = %.4g units\n", sqrt(sumSquares / ADCCOUNTS),
+            sqrt(sumSquares / ADCCOUNTS) * curve->units);
+    fprintf(out, "Tolerance   %ld LSB: %s\n", curve->tolerance, fabs(maxError) <= curve->tolerance ? "pass" : "FAIL");
+    return fabs(maxError) <= curve->tolerance ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    curve_t curve;
+    int16_t table[MAXENTRIES];
+    int check = argc == 3 && !strcmp(argv[1], "--check");
+    const char *fileName = argv[argc - 1];
+    int entries;
+
+    if (!(argc == 2 || check))
+    {
+        fprintf(stderr, "Usage: %s [--check] curve.txt\n", argv[0]);
+        return 2;
+    }
+    if (!readCurve(fileName, &curve))
+        return 2;
+    entries = buildTable(&curve, table);
+    if (!entries)
+        return 2;
+    if (check)
+        return runCheck(stdout, &curve, table);
+    if (runCheck(stderr, &curve, table))
+    {
+        fprintf(stderr, "%s: table over tolerance, no header written\n", fileName);
+        return 1;
+    }
+    writeHeader(fileName, &curve, table, entries);
+    return 0;
+}
@@ -0,0 +1,1602 @@
+// ---------------------------------------------------------------------
+// PIC12F1840 emulator for the host PC, runs the .production.hex images built
+// from the demo code so that firmware cycle costs can be measured and the
+// display and pin behaviour checked without hardware. Standard C, build with eg.:
+//     cc -O2 -o pic12f1840emu host/pic12f1840emu.c
+//
+// Usage:
+//     pic12f1840emu [options] image.hex
+//     --ms N              Simulated run time in ms, default 3000
+//     --updates N         Stop after N complete TM1637 display updates
+//     --an N=mV           Voltage on analogue input ANn, 0..3, default 0mV
+//     --vdd mV            Supply voltage, default 5000mV
+//     --pin RAn=0|1       Level driven onto an input pin
+//     --square RAn=Hz[:duty%]   Square wave driven onto an input pin, default 50% duty
+//     --no-tm1637         No TM1637 module on RA4 (DIO) and RA5 (CLK)
+//     --int-latency N     Interrupt entry cycles, 3..5, default 3
+//     --vcd file          Record RA0..RA5 pin waveforms as a VCD file, eg. for GTKWave
+//     --profile file      Write execution count and cycles for every executed address
+//     --top N             Number of hot spot addresses in the summary, default 15
+//     --quiet             Don't print display updates as they happen
+//
+// Model:
+// Enhanced mid-range core, all 49 instructions, 16 level stack, hardware context save on
+// interrupt, banked, linear and program memory FSR addressing. Cycle counts are per the
+// datasheet: 1 cycle, 2 for branches, calls, returns, taken skips and writes to PCL, plus 1
+// for a program memory read through INDF. Interrupt latency is the datasheet's 3-4 cycles for
+// synchronous sources and 3-5 for asynchronous ones (interrupt on change, INT pin): the instruction
+// in progress when the flag is set completes, adding the 4th cycle for 2 cycle instructions, then
+// entry takes --int-latency cycles, 3 by default. The async 5th cycle is not modelled, so by default
+// interrupt timings are a lower bound, run with --int-latency 4 or 5 for the worst case.
+// Peripherals: PORTA/LATA/TRISA/ANSELA, oscillator (OSCCON/OSCSTAT, 4x PLL), Timer0, Timer1
+// with gate, Timer2, CCP1 capture and PWM, ADC, FVR, interrupts. The TM1637 module is modelled
+// at bus level: it ACKs bytes and decodes the segment data written. Unmodelled SFRs read back
+// as written. Analogue values, oscillator start up times and FRC are typical values.
+// -----------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FLASHWORDS 4096
+#define DATASIZE 4096                  // 32 banks x 128 bytes, addressed as bank << 7 | offset
+#define STACKDEPTH 16
+#define PINS 6
+
+// STATUS bits:
+#define STATUSC 0x01
+#define STATUSDC 0x02
+#define STATUSZ 0x04
+
+// Core register offsets, present in every bank:
+#define INDF0 0x00
+#define INDF1 0x01
+#define PCL 0x02
+#define STATUS 0x03
+#define FSR0L 0x04
+#define FSR0H 0x05
+#define FSR1L 0x06
+#define FSR1H 0x07
+#define BSR 0x08
+#define WREG 0x09
+#define PCLATH 0x0A
+#define INTCON 0x0B
+
+// SFR addresses, bank << 7 | offset:
+#define PORTA 0x00C
+#define PIR1 0x011
+#define PIR2 0x012
+#define TMR0 0x015
+#define TMR1L 0x016
+#define TMR1H 0x017
+#define T1CON 0x018
+#define T1GCON 0x019
+#define TMR2 0x01A
+#define PR2 0x01B
+#define T2CON 0x01C
+#define TRISA 0x08C
+#define PIE1 0x091
+#define PIE2 0x092
+#define OPTION_REG 0x095
+#define OSCCON 0x099
+#define OSCSTAT 0x09A
+#define ADRESL 0x09B
+#define ADRESH 0x09C
+#define ADCON0 0x09D
+#define ADCON1 0x09E
+#define LATA 0x10C
+#define FVRCON 0x117
+#define APFCON 0x11D
+#define ANSELA 0x18C
+#define CCPR1L 0x291
+#define CCPR1H 0x292
+#define CCP1CON 0x293
+
+// Oscillator and analogue timing, typical datasheet values:
+#define HFINTOSCSTARTNS 5000.0         // HFINTOSC start up to HFIOFR/HFIOFS
+#define PLLLOCKNS 2000000.0            // 4x PLL lock time TPLLST, 2ms
+#define FVRSTARTNS 25000.0             // FVR settling to FVRRDY
+#define FRCTADNS 1600.0                // ADC FRC clock period
+#define TM1637ACKHOLD 1                // TM1637 holds DIO low for the ACK clock
+
+typedef struct
+{
+    int active;
+    double periodNs;
+    double highNs;
+    int level;                         // Static level if not a square wave
+} pinInput_t;
+
+typedef struct
+{
+    int attached;
+    int lastClk;
+    int lastDio;
+    int inTransfer;
+    int bitCount;
+    uint8_t shift;
+    int byteCount;
+    int ackPending;                    // Set after 8 bits, ACK driven from the next CLK low
+    int ackDriving;                    // Device is pulling DIO low
+    uint8_t command;                   // First byte of the current transfer
+    uint8_t address;
+    uint8_t segments[6];
+    uint8_t control;                   // Last display control command
+    int dataWritten;                   // Segment data written in this transfer
+    long updates;                      // Complete address + data transfers
+    double firstUpdateNs;
+} tm1637_t;
+
+typedef struct
+{
+    // Program memory and configuration:
+    uint16_t flash[FLASHWORDS];
+    uint16_t config1;
+    uint16_t config2;
+
+    // Core:
+    uint8_t data[DATASIZE];            // SFRs and GPR, core registers and common RAM stored in bank 0
+    uint16_t pc;
+    uint16_t stack[STACKDEPTH];
+    int sp;
+    uint8_t shadow[12];                // Shadow copies of core registers saved on interrupt
+    int sleeping;
+    int halted;
+    const char *haltReason;
+
+    // Time:
+    uint64_t cycles;                   // Instruction cycles
+    uint64_t instructions;
+    uint64_t interrupts;
+    double timeNs;
+    double fosc;                       // Current system clock, Hz
+    double hfStartNs;                  // Time HFINTOSC was selected, < 0 if not running
+    double pllStartNs;                 // Time the PLL was enabled, < 0 if off
+    double fvrStartNs;
+
+    // Peripherals:
+    int tmr0Prescale;
+    int tmr1Prescale;
+    int tmr1GateLast;
+    int tmr1GateToggle;
+    int tmr1SinglePulseArmed;
+    int tmr2Prescale;
+    int tmr2Postscale;
+    uint8_t pwmDutyHigh;               // CCPR1H, latched each PWM period
+    uint8_t pwmDutyLow;
+    int ccpLastPin;
+    int ccpEdgeCount;
+    double adcEndNs;                   // Time current conversion completes, < 0 if none
+    uint16_t adcResult;
+    double anMv[4];
+    double vddMv;
+    pinInput_t input[PINS];
+    tm1637_t tm1637;
+
+    // Results:
+    uint64_t *execCount;
+    uint64_t *execCycles;
+    uint8_t pinState;
+    FILE *vcd;
+    int quiet;
+    int intLatency;                    // Interrupt entry cycles after the current instruction
+} pic_t;
+
+static pic_t pic;
+
+//*******************************************************************************************
+// Intel HEX loader, byte addresses, program words are stored low byte first
+//*******************************************************************************************
+
+static int hexByte(const char *text)
+{
+    unsigned value;
+    if (sscanf(text, "%2x", &value) != 1)
+        return -1;
+    return (int)value;
+}
+
+static int loadHex(pic_t *p, const char *fileName)
+{
+    FILE *file = fopen(fileName, "r");
+    char line[600];
+    uint32_t upper = 0;
+    int lineNumber = 0;
+
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open %s\n", fileName);
+        return 0;
+    }
+    for (int i = 0; i < FLASHWORDS; i++)
+        p->flash[i] = 0x3FFF;          // Erased flash
+    p->config1 = 0x3FFF;
+    p->config2 = 0x3FFF;
+    while (fgets(line, sizeof(line), file))
+    {
+        lineNumber ++;
+        if (line[0] != ':')
+            continue;
+        int count = hexByte(line + 1);
+        int addressHigh = hexByte(line + 3);
+        int addressLow = hexByte(line + 5);
+        int type = hexByte(line + 7);
+        uint8_t bytes[256];
+        int sum = count + addressHigh + addressLow + type;
+        if (count < 0 || addressHigh < 0 || addressLow < 0 || type < 0 || (int)strlen(line) < 11 + count * 2)
+        {
+            fprintf(stderr, "%s:%d: bad record\n", fileName, lineNumber);
+            fclose(file);
+            return 0;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            bytes[i] = (uint8_t)hexByte(line + 9 + i * 2);
+            sum += bytes[i];
+        }
+        sum += hexByte(line + 9 + count * 2);
+        if (sum & 0xFF)
+        {
+            fprintf(stderr, "%s:%d: checksum error\n", fileName, lineNumber);
+            fclose(file);
+            return 0;
+        }
+        if (type == 1)
+            break;
+        if (type == 4 && count == 2)
+            upper = ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16);
+        else if (type == 2 && count == 2)
+            upper = (((uint32_t)bytes[0] << 8) | bytes[1]) << 4;
+        else if (type == 0)
+        {
+            uint32_t address = upper + ((uint32_t)addressHigh << 8) + (uint32_t)addressLow;
+            for (int i = 0; i < count; i++)
+            {
+                uint32_t byteAddress = address + (uint32_t)i;
+                uint32_t word = byteAddress >> 1;
+                uint16_t *target = NULL;
+                if (word < FLASHWORDS)
+                    target = &p->flash[word];
+                else if (word == 0x8007)
+                    target = &p->config1;
+                else if (word == 0x8008)
+                    target = &p->config2;
+                if (!target)
+                    continue;              // User ID, device ID etc. not needed
+                if (byteAddress & 1)
+                    *target = (uint16_t)((*target & 0x00FF) | ((bytes[i] & 0x3F) << 8));
+                else
+                    *target = (uint16_t)((*target & 0xFF00) | bytes[i]);
+            }
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+//*******************************************************************************************
+// Clock
+//*******************************************************************************************
+
+static const double ircfHz[16] = {31000, 31250, 31250, 31250, 62500, 125000, 250000, 500000,
+                                  125000, 250000, 500000, 1000000, 2000000, 4000000, 8000000, 16000000};
+
+static int pllRequested(pic_t *p)
+{
+    uint8_t osccon = p->data[OSCCON];
+    return ((osccon >> 3) & 0x0F) == 0x0E && ((osccon & 0x80) || (p->config2 & 0x0100));
+}
+
+static void updateClock(pic_t *p)      // Called after OSCCON writes and as start up timers expire
+{
+    uint8_t osccon = p->data[OSCCON];
+    int ircf = (osccon >> 3) & 0x0F;
+    int hf = ircf >= 0x08 || ircf == 0x03;       // HFINTOSC derived frequencies
+
+    if (hf && p->hfStartNs < 0)
+        p->hfStartNs = p->timeNs;
+    if (pllRequested(p))
+    {
+        if (p->pllStartNs < 0)
+            p->pllStartNs = p->timeNs;
+    }
+    else
+        p->pllStartNs = -1;
+    p->fosc = ircfHz[ircf];
+    if (pllRequested(p) && p->timeNs - p->pllStartNs >= PLLLOCKNS)
+        p->fosc = 32000000.0;
+}
+
+static uint8_t readOscstat(pic_t *p)
+{
+    uint8_t value = 0x20 | 0x04 | 0x02;              // OSTS, MFIOFR, LFIOFR
+    if (p->hfStartNs >= 0 && p->timeNs - p->hfStartNs >= HFINTOSCSTARTNS)
+        value |= 0x10 | 0x08 | 0x01;                 // HFIOFR, HFIOFL, HFIOFS
+    if (p->pllStartNs >= 0 && p->timeNs - p->pllStartNs >= PLLLOCKNS)
+        value |= 0x40;                               // PLLR
+    return value;
+}
+
+//*******************************************************************************************
+// Pins: level seen on each RA pin from the PIC output, external inputs and the TM1637
+//*******************************************************************************************
+
+static int ccp1Pin(pic_t *p)
+{
+    return (p->data[APFCON] & 0x01) ? 5 : 2;
+}
+
+static int pwmOutput(pic_t *p)         // CCP1 PWM output level at the current Timer2 position
+{
+    static const int t2Divide[4] = {1, 4, 16, 64};
+    int divide = t2Divide[p->data[T2CON] & 0x03];
+    uint32_t duty = ((uint32_t)p->pwmDutyHigh << 2) | p->pwmDutyLow;
+    uint32_t positionQ = ((uint32_t)p->data[TMR2] * (uint32_t)divide + (uint32_t)p->tmr2Prescale) * 4;
+    return positionQ < duty * (uint32_t)divide;
+}
+
+static int pinLevel(pic_t *p, int pin)
+{
+    int level;
+    int tris = (p->data[TRISA] >> pin) & 1;
+    if (!tris && pin != 3)                              // RA3 is input only
+    {
+        level = (p->data[LATA] >> pin) & 1;
+        if (pin == ccp1Pin(p) && (p->data[CCP1CON] & 0x0C) == 0x0C)
+            level = pwmOutput(p);
+        if (pin == 4 && p->tm1637.attached && p->tm1637.ackDriving)
+            level = 0;                                  // Contention, device pulls low
+        return level;
+    }
+    if (p->input[pin].active)
+    {
+        if (p->input[pin].periodNs > 0)
+        {
+            double phase = p->timeNs - p->input[pin].periodNs * (double)(uint64_t)(p->timeNs / p->input[pin].periodNs);
+            return phase < p->input[pin].highNs;
+        }
+        return p->input[pin].level;
+    }
+    if (p->tm1637.attached && (pin == 4 || pin == 5))
+    {
+        if (pin == 4 && p->tm1637.ackDriving)
+            return 0;
+        return 1;                                       // Module pull ups
+    }
+    return 0;
+}
+
+static void tm1637Byte(pic_t *p, uint8_t value)
+{
+    tm1637_t *t = &p->tm1637;
+    if (t->byteCount == 0)
+    {
+        t->command = value;
+        if ((value & 0xC0) == 0xC0)
+            t->address = value & 0x07;
+        else if ((value & 0xC0) == 0x80)
+            t->control = value;
+    }
+    else if ((t->command & 0xC0) == 0xC0)
+    {
+        if (t->address < 6)
+            t->segments[t->address] = value;
+        t->address ++;
+        t->dataWritten = 1;
+    }
+    t->byteCount ++;
+}
+
+static char segmentChar(uint8_t segments)
+{
+    static const uint8_t digits[10] = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f};
+    segments &= 0x7F;
+    if (!segments)
+        return ' ';
+    for (int i = 0; i < 10; i++)
+        if (digits[i] == segments)
+            return (char)('0' + i);
+    if (segments == 0x40)
+        return '-';
+    return '?';
+}
+
+static void tm1637Text(pic_t *p, char *text)   // 4 digit display as text, decimal points included
+{
+    int n = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        text[n++] = segmentChar(p->tm1637.segments[i]);
+        if (p->tm1637.segments[i] & 0x80)
+            text[n++] = '.';
+    }
+    text[n] = 0;
+}
+
+static void tm1637Update(pic_t *p)     // Called whenever the CLK or DIO line may have changed
+{
+    tm1637_t *t = &p->tm1637;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        int clk = pinLevel(p, 5);
+        int dio = pinLevel(p, 4);
+        if (clk == t->lastClk && dio == t->lastDio)
+            return;
+        if (clk && t->lastClk && dio != t->lastDio)
+        {
+            if (!dio)                  // Start, DIO falls with CLK high
+            {
+                t->inTransfer = 1;
+                t->bitCount = 0;
+                t->byteCount = 0;
+                t->shift = 0;
+                t->dataWritten = 0;
+                t->ackPending = 0;
+            }
+            else if (t->inTransfer)    // Stop, DIO rises with CLK high
+            {
+                t->inTransfer = 0;
+                if (t->dataWritten)
+                {
+                    char text[16];
+                    t->updates ++;
+                    if (t->updates == 1)
+                        t->firstUpdateNs = p->timeNs;
+                    tm1637Text(p, text);
+                    if (!p->quiet)
+                        printf("%12.3f ms  display \"%s\"\n", p->timeNs / 1e6, text);
+                }
+            }
+        }
+        else if (t->inTransfer && clk && !t->lastClk)           // CLK rising, data bit
+        {
+            if (t->bitCount < 8)
+            {
+                t->shift = (uint8_t)((t->shift >> 1) | (dio ? 0x80 : 0));
+                if (++t->bitCount == 8)
+                {
+                    tm1637Byte(p, t->shift);
+                    t->ackPending = 1;
+                }
+            }
+        }
+        else if (t->inTransfer && !clk && t->lastClk)           // CLK falling
+        {
+            if (t->ackPending)
+            {
+                t->ackPending = 0;
+                t->ackDriving = TM1637ACKHOLD;
+                t->bitCount = 9;
+            }
+            else if (t->ackDriving)
+            {
+                t->ackDriving = 0;     // ACK clock done
+                t->bitCount = 0;
+                t->shift = 0;
+            }
+            else if (t->bitCount == 9)
+                t->bitCount = 0;
+        }
+        t->lastClk = clk;
+        t->lastDio = dio;
+    }
+}
+
+static void recordPins(pic_t *p)
+{
+    uint8_t state = 0;
+    for (int pin = 0; pin < PINS; pin++)
+        state |= (uint8_t)(pinLevel(p, pin) << pin);
+    if (state == p->pinState)
+        return;
+    if (p->vcd)
+    {
+        fprintf(p->vcd, "#%llu\n", (unsigned long long)(p->timeNs + 0.5));
+        for (int pin = 0; pin < PINS; pin++)
+            if (((state ^ p->pinState) >> pin) & 1)
+                fprintf(p->vcd, "%d%c\n", (state >> pin) & 1, '0' + pin);
+    }
+    p->pinState = state;
+}
+
+//*******************************************************************************************
+// Data memory access
+//*******************************************************************************************
+
+static uint8_t readFile(pic_t *p, uint16_t address);
+static void writeFile(pic_t *p, uint16_t address, uint8_t value);
+
+static uint16_t fsr(pic_t *p, int n)
+{
+    return (uint16_t)(p->data[n ? FSR1L : FSR0L] | (p->data[n ? FSR1H : FSR0H] << 8));
+}
+
+static void setFsr(pic_t *p, int n, uint16_t value)
+{
+    p->data[n ? FSR1L : FSR0L] = (uint8_t)value;
+    p->data[n ? FSR1H : FSR0H] = (uint8_t)(value >> 8);
+}
+
+static int extraCycles;                // Added to the current instruction, eg. program memory reads
+
+static uint8_t readIndirect(pic_t *p, uint16_t address)
+{
+    if (address >= 0x8000)             // Program memory, low byte of the word
+    {
+        extraCycles = 1;
+        return (uint8_t)p->flash[(address - 0x8000) % FLASHWORDS];
+    }
+    if (address >= 0x2000 && address < 0x29B0)    // Linear GPR, 80 bytes per bank
+    {
+        uint16_t offset = address - 0x2000;
+        return readFile(p, (uint16_t)(((offset / 80) << 7) | (0x20 + offset % 80)));
+    }
+    if (address < 0x1000)
+    {
+        if ((address & 0x7F) <= INDF1)
+            return 0;                  // INDF through INDF reads 0
+        return readFile(p, address);
+    }
+    return 0;
+}
+
+static void writeIndirect(pic_t *p, uint16_t address, uint8_t value)
+{
+    if (address >= 0x2000 && address < 0x29B0)
+    {
+        uint16_t offset = address - 0x2000;
+        writeFile(p, (uint16_t)(((offset / 80) << 7) | (0x20 + offset % 80)), value);
+    }
+    else if (address < 0x1000 && (address & 0x7F) > INDF1)
+        writeFile(p, address, value);
+}
+
+static uint8_t readFile(pic_t *p, uint16_t address)
+{
+    uint8_t offset = address & 0x7F;
+    if (offset < 0x0C)                 // Core registers
+    {
+        if (offset == INDF0 || offset == INDF1)
+            return readIndirect(p, fsr(p, offset));
+        if (offset == PCL)
+            return (uint8_t)p->pc;
+        return p->data[offset];
+    }
+    if (offset >= 0x70)                // Common RAM
+        return p->data[offset];
+    switch (address)
+    {
+        case PORTA:
+        {
+            uint8_t value = 0;
+            for (int pin = 0; pin < PINS; pin++)
+                if (!((p->data[ANSELA] >> pin) & 1))
+                    value |= (uint8_t)(pinLevel(p, pin) << pin);
+            return value;
+        }
+        case OSCSTAT:
+            return readOscstat(p);
+        case FVRCON:
+            return (uint8_t)((p->data[FVRCON] & 0xBF) |
+                   ((p->data[FVRCON] & 0x80) && p->timeNs - p->fvrStartNs >= FVRSTARTNS ? 0x40 : 0));
+    }
+    return p->data[address];
+}
+
+static void startConversion(pic_t *p)
+{
+    static const int tadDivide[8] = {2, 8, 32, 0, 4, 16, 64, 0};
+    int adcs = (p->data[ADCON1] >> 4) & 0x07;
+    double tadNs = tadDivide[adcs] ? tadDivide[adcs] * 1e9 / p->fosc : FRCTADNS;
+    int channel = (p->data[ADCON0] >> 2) & 0x1F;
+    double vinMv = 0;
+    double vrefMv = p->vddMv;
+    static const double fvrMv[4] = {0, 1024, 2048, 4096};
+
+    if (channel < 4)
+        vinMv = p->anMv[channel];
+    else if (channel == 0x1F && (p->data[FVRCON] & 0x80))
+        vinMv = fvrMv[p->data[FVRCON] & 0x03];
+    if ((p->data[ADCON1] & 0x03) == 0x03)
+        vrefMv = (p->data[FVRCON] & 0x80) ? fvrMv[p->data[FVRCON] & 0x03] : 0;
+    else if ((p->data[ADCON1] & 0x03) == 0x02)
+        vrefMv = p->anMv[1];           // Vref+ pin
+    double counts = vrefMv > 0 ? vinMv * 1024.0 / vrefMv : 1023;
+    p->adcResult = counts >= 1023 ? 1023 : counts < 0 ? 0 : (uint16_t)counts;
+    p->adcEndNs = p->timeNs + 11.5 * tadNs;
+}
+
+static void writeFile(pic_t *p, uint16_t address, uint8_t value)
+{
+    uint8_t offset = address & 0x7F;
+    if (offset < 0x0C)
+    {
+        switch (offset)
+        {
+            case INDF0:
+            case INDF1:
+                writeIndirect(p, fsr(p, offset), value);
+                break;
+            case PCL:
+                p->pc = (uint16_t)(((p->data[PCLATH] & 0x7F) << 8) | value);
+                extraCycles = 1;
+                break;
+            case STATUS:
+                p->data[STATUS] = (uint8_t)((p->data[STATUS] & 0x18) | (value & 0x07));
+                break;
+            case BSR:
+                p->data[BSR] = value & 0x1F;
+                break;
+            case PCLATH:
+                p->data[PCLATH] = value & 0x7F;
+                break;
+            default:
+                p->data[offset] = value;
+                break;
+        }
+        return;
+    }
+    if (offset >= 0x70)
+    {
+        p->data[offset] = value;
+        return;
+    }
+    switch (address)
+    {
+        case PORTA:                    // Writes to PORTA go to the output latch
+            p->data[LATA] = value & 0x37;
+            return;
+        case LATA:
+            p->data[LATA] = value & 0x37;
+            return;
+        case TRISA:
+            p->data[TRISA] = value | 0x08;
+            return;
+        case OSCCON:
+            p->data[OSCCON] = value & 0xFB;
+            updateClock(p);
+            return;
+        case OSCSTAT:
+            return;
+        case TMR0:
+            p->data[TMR0] = value;
+            p->tmr0Prescale = 0;
+            return;
+        case TMR1L:
+        case TMR1H:
+            p->data[address] = value;
+            p->tmr1Prescale = 0;
+            return;
+        case TMR2:
+            p->data[TMR2] = value;
+            p->tmr2Prescale = 0;
+            return;
+        case T2CON:
+            p->data[T2CON] = value & 0x7F;
+            return;
+        case ADCON0:
+            p->data[ADCON0] = value & 0x7F;
+            if ((value & 0x03) == 0x03 && p->adcEndNs < 0)
+                startConversion(p);
+            else if (!(value & 0x02))
+                p->adcEndNs = -1;      // Conversion aborted
+            return;
+        case FVRCON:
+            if ((value & 0x80) && !(p->data[FVRCON] & 0x80))
+                p->fvrStartNs = p->timeNs;
+            p->data[FVRCON] = value & 0xBF;
+            return;
+        case T1GCON:
+            if ((value & 0x08) && !(p->data[T1GCON] & 0x08))
+                p->tmr1SinglePulseArmed = 1;
+            p->data[T1GCON] = (uint8_t)((value & 0xFB) | (p->data[T1GCON] & 0x04));
+            return;
+        case CCP1CON:
+            if ((value & 0x0F) != (p->data[CCP1CON] & 0x0F))
+                p->ccpEdgeCount = 0;
+            p->data[CCP1CON] = value;
+            return;
+    }
+    p->data[address] = value;
+}
+
+//*******************************************************************************************
+// Peripherals, advanced one instruction cycle at a time
+//*******************************************************************************************
+
+static int timer1Gate(pic_t *p)        // Timer1 gate enable, 1 = count
+{
+    uint8_t t1gcon = p->data[T1GCON];
+    if (!(t1gcon & 0x80))              // TMR1GE clear, always counting
+        return 1;
+    int source = 0;
+    switch (t1gcon & 0x03)
+    {
+        case 0:
+            source = pinLevel(p, (p->data[APFCON] & 0x08) ? 3 : 4);   // T1G pin, T1GSEL selects RA3/RA4
+            break;
+        case 1:
+            source = 0;                // Timer0 overflow pulse, not modelled
+            break;
+        default:
+            source = 0;                // Comparator output, comparator not modelled
+            break;
+    }
+    if (!(t1gcon & 0x40))              // T1GPOL, active low gate
+        source = !source;
+    int rising = source && !p->tmr1GateLast;
+    int falling = !source && p->tmr1GateLast;
+    p->tmr1GateLast = source;
+    if (t1gcon & 0x20)                 // T1GTM toggle mode, gate flips on each rising edge
+    {
+        if (rising)
+            p->tmr1GateToggle = !p->tmr1GateToggle;
+        falling = rising && !p->tmr1GateToggle;
+        rising = rising && p->tmr1GateToggle;
+        source = p->tmr1GateToggle;
+    }
+    if (t1gcon & 0x10)                 // T1GSPM single pulse mode
+    {
+        if (!(t1gcon & 0x08))          // T1GGO/DONE clear, not armed
+            return 0;
+        if (rising)
+            p->tmr1SinglePulseArmed = 2;
+        if (falling && p->tmr1SinglePulseArmed == 2)
+        {
+            p->data[T1GCON] &= ~0x08;  // Done
+            p->data[PIR1] |= 0x80;     // TMR1GIF
+            p->tmr1SinglePulseArmed = 0;
+            return 0;
+        }
+        return p->tmr1SinglePulseArmed == 2 && source;
+    }
+    if (falling)
+        p->data[PIR1] |= 0x80;         // TMR1GIF on gate inactive edge
+    return source;
+}
+
+static void stepPeripherals(pic_t *p)
+{
+    double tcyNs = 4e9 / p->fosc;
+    p->timeNs += tcyNs;
+    p->cycles ++;
+
+    if (p->pllStartNs >= 0 && p->fosc < 32000000.0 && p->timeNs - p->pllStartNs >= PLLLOCKNS)
+        updateClock(p);
+
+    // T1GCON T1GVAL reflects the gate state:
+    int gate = timer1Gate(p);
+    p->data[T1GCON] = (uint8_t)((p->data[T1GCON] & ~0x04) | (gate ? 0x04 : 0));
+
+    // Timer0, Fosc/4 clock only:
+    uint8_t option = p->data[OPTION_REG];
+    if (!(option & 0x20))
+    {
+        int divide = (option & 0x08) ? 1 : 2 << (option & 0x07);
+        if (++p->tmr0Prescale >= divide)
+        {
+            p->tmr0Prescale = 0;
+            if (++p->data[TMR0] == 0)
+                p->data[INTCON] |= 0x04;        // TMR0IF
+        }
+    }
+
+    // Timer1, Fosc/4 or Fosc clock:
+    uint8_t t1con = p->data[T1CON];
+    if ((t1con & 0x01) && gate && (t1con & 0x80) == 0)
+    {
+        int ticks = (t1con & 0x40) ? 4 : 1;
+        int divide = 1 << ((t1con >> 4) & 0x03);
+        for (int i = 0; i < ticks; i++)
+        {
+            if (++p->tmr1Prescale >= divide)
+            {
+                p->tmr1Prescale = 0;
+                if (++p->data[TMR1L] == 0 && ++p->data[TMR1H] == 0)
+                    p->data[PIR1] |= 0x01;      // TMR1IF
+            }
+        }
+    }
+
+    // Timer2 and CCP1 PWM:
+    uint8_t t2con = p->data[T2CON];
+    if (t2con & 0x04)
+    {
+        static const int t2Divide[4] = {1, 4, 16, 64};
+        int divide = t2Divide[t2con & 0x03];
+        if (++p->tmr2Prescale >= divide)
+        {
+            p->tmr2Prescale = 0;
+            if (p->data[TMR2] == p->data[PR2])
+            {
+                p->data[TMR2] = 0;
+                p->pwmDutyHigh = p->data[CCPR1L];               // Duty latched at period start
+                p->pwmDutyLow = (p->data[CCP1CON] >> 4) & 0x03;
+                p->data[CCPR1H] = p->data[CCPR1L];
+                if (++p->tmr2Postscale > ((t2con >> 3) & 0x0F))
+                {
+                    p->tmr2Postscale = 0;
+                    p->data[PIR1] |= 0x02;      // TMR2IF
+                }
+            }
+            else
+                p->data[TMR2] ++;
+        }
+    }
+
+    // CCP1 capture of Timer1:
+    uint8_t ccpMode = p->data[CCP1CON] & 0x0F;
+    if (ccpMode >= 0x04 && ccpMode <= 0x07)
+    {
+        int level = (p->data[TRISA] >> ccp1Pin(p)) & 1 ? pinLevel(p, ccp1Pin(p)) : 0;
+        int edge = ccpMode == 0x04 ? (!level && p->ccpLastPin) : (level && !p->ccpLastPin);
+        p->ccpLastPin = level;
+        if (edge)
+        {
+            int every = ccpMode == 0x06 ? 4 : ccpMode == 0x07 ? 16 : 1;
+            if (++p->ccpEdgeCount >= every)
+            {
+                p->ccpEdgeCount = 0;
+                p->data[CCPR1L] = p->data[TMR1L];
+                p->data[CCPR1H] = p->data[TMR1H];
+                p->data[PIR1] |= 0x04;          // CCP1IF
+            }
+        }
+    }
+
+    // ADC:
+    if (p->adcEndNs >= 0 && p->timeNs >= p->adcEndNs)
+    {
+        p->adcEndNs = -1;
+        if (p->data[ADCON1] & 0x80)    // ADFM right justified
+        {
+            p->data[ADRESH] = (uint8_t)(p->adcResult >> 8);
+            p->data[ADRESL] = (uint8_t)p->adcResult;
+        }
+        else
+        {
+            p->data[ADRESH] = (uint8_t)(p->adcResult >> 2);
+            p->data[ADRESL] = (uint8_t)(p->adcResult << 6);
+        }
+        p->data[ADCON0] &= ~0x02;      // GO/DONE clear
+        p->data[PIR1] |= 0x40;         // ADIF
+    }
+
+    if (p->tm1637.attached)
+        tm1637Update(p);
+    recordPins(p);
+}
+
+//*******************************************************************************************
+// Core
+//*******************************************************************************************
+
+static void push(pic_t *p, uint16_t address)
+{
+    if (p->sp >= STACKDEPTH)
+    {
+        p->halted = 1;
+        p->haltReason = "stack overflow";
+        return;
+    }
+    p->stack[p->sp++] = address;
+}
+
+static uint16_t pop(pic_t *p)
+{
+    if (p->sp <= 0)
+    {
+        p->halted = 1;
+        p->haltReason = "stack underflow";
+        return 0;
+    }
+    return p->stack[--p->sp];
+}
+
+static void setFlags(pic_t *p, uint8_t mask, uint8_t flags)
+{
+    p->data[STATUS] = (uint8_t)((p->data[STATUS] & ~mask) | (flags & mask));
+}
+
+static uint8_t add(pic_t *p, uint8_t a, uint8_t b, int carryIn)  // Sets C, DC, Z
+{
+    unsigned result = (unsigned)a + b + (unsigned)carryIn;
+    uint8_t flags = 0;
+    if (result > 0xFF)
+        flags |= STATUSC;
+    if ((a & 0x0F) + (b & 0x0F) + carryIn > 0x0F)
+        flags |= STATUSDC;
+    if (!(result & 0xFF))
+        flags |= STATUSZ;
+    setFlags(p, STATUSC | STATUSDC | STATUSZ, flags);
+    return (uint8_t)result;
+}
+
+static void setZ(pic_t *p, uint8_t value)
+{
+    setFlags(p, STATUSZ, value ? 0 : STATUSZ);
+}
+
+static int moviwFsr(pic_t *p, int n, int mode, uint16_t *address)  // MOVIW/MOVWI ++,--,++,-- modes
+{
+    uint16_t value = fsr(p, n);
+    switch (mode)
+    {
+        case 0: value ++; setFsr(p, n, value); *address = value; break;   // ++FSRn
+        case 1: value --; setFsr(p, n, value); *address = value; break;   // --FSRn
+        case 2: *address = value; setFsr(p, n, value + 1); break;         // FSRn++
+        default: *address = value; setFsr(p, n, value - 1); break;        // FSRn--
+    }
+    return 0;
+}
+
+static int signExtend(int value, int bits)
+{
+    int sign = 1 << (bits - 1);
+    return (value ^ sign) - sign;
+}
+
+static int execute(pic_t *p, uint16_t op)  // Executes one instruction at p->pc - 1, returns cycles
+{
+    int cycles = 1;
+    extraCycles = 0;
+
+    if ((op & 0x3000) == 0x0000)
+    {
+        if ((op & 0x3F80) == 0x0000)   // Inherent, MOVLB, MOVIW/MOVWI indirect
+        {
+            if (op >= 0x0010 && op <= 0x001F)
+            {
+                uint16_t address;
+                moviwFsr(p, (op >> 2) & 1, op & 3, &address);
+                if (op & 0x08)
+                    writeIndirect(p, address, p->data[WREG]);
+                else
+                {
+                    p->data[WREG] = readIndirect(p, address);
+                    setZ(p, p->data[WREG]);
+                }
+            }
+            else if (op >= 0x0020 && op <= 0x003F)
+                p->data[BSR] = op & 0x1F;                 // MOVLB
+            else
+            {
+                switch (op)
+                {
+                    case 0x0000:                           // NOP
+                        break;
+                    case 0x0001:                           // RESET
+                        p->halted = 1;
+                        p->haltReason = "RESET instruction";
+                        break;
+                    case 0x0008:                           // RETURN
+                        p->pc = pop(p);
+                        cycles = 2;
+                        break;
+                    case 0x0009:                           // RETFIE, restore shadow registers
+                        p->pc = pop(p);
+                        p->data[WREG] = p->shadow[WREG];
+                        p->data[STATUS] = (uint8_t)((p->data[STATUS] & 0x18) | (p->shadow[STATUS] & 0x07));
+                        p->data[BSR] = p->shadow[BSR];
+                        p->data[PCLATH] = p->shadow[PCLATH];
+                        p->data[FSR0L] = p->shadow[FSR0L];
+                        p->data[FSR0H] = p->shadow[FSR0H];
+                        p->data[FSR1L] = p->shadow[FSR1L];
+                        p->data[FSR1H] = p->shadow[FSR1H];
+                        p->data[INTCON] |= 0x80;
+                        cycles = 2;
+                        break;
+                    case 0x000A:                           // CALLW
+                        push(p, p->pc);
+                        p->pc = (uint16_t)((p->data[PCLATH] << 8) | p->data[WREG]);
+                        cycles = 2;
+                        break;
+                    case 0x000B:                           // BRW
+                        p->pc = (uint16_t)(p->pc + p->data[WREG]);
+                        cycles = 2;
+                        break;
+                    case 0x0062:                           // OPTION
+                        p->data[OPTION_REG] = p->data[WREG];
+                        break;
+                    case 0x0063:                           // SLEEP
+                        p->sleeping = 1;
+                        p->data[STATUS] = (uint8_t)((p->data[STATUS] & ~0x08) | 0x10);
+                        break;
+                    case 0x0064:                           // CLRWDT
+                        p->data[STATUS] |= 0x18;
+                        break;
+                    case 0x0065:
+                    case 0x0066:
+                    case 0x0067:                           // TRIS, only PORTA exists
+                        if (op == 0x0065)
+                            writeFile(p, TRISA, p->data[WREG]);
+                        break;
+                    default:
+                        break;                             // Unimplemented codes execute as NOP
+                }
+            }
+        }
+        else
+        {
+            int nibble = (op >> 8) & 0x0F;
+            int toFile = (op >> 7) & 1;
+            uint16_t address = (uint16_t)((p->data[BSR] << 7) | (op & 0x7F));
+            uint8_t w = p->data[WREG];
+            uint8_t value;
+            uint8_t result = 0;
+            int store = 1;
+
+            if (nibble == 0x0)         // MOVWF
+            {
+                writeFile(p, address, w);
+                return cycles + extraCycles;
+            }
+            if (nibble == 0x1)         // CLRF / CLRW
+            {
+                if (toFile)
+                    writeFile(p, address, 0);
+                else
+                    p->data[WREG] = 0;
+                setFlags(p, STATUSZ, STATUSZ);
+                return cycles + extraCycles;
+            }
+            value = readFile(p, address);
+            switch (nibble)
+            {
+                case 0x2: result = add(p, value, (uint8_t)~w, 1); break;          // SUBWF
+                case 0x3: result = (uint8_t)(value - 1); setZ(p, result); break;   // DECF
+                case 0x4: result = value | w; setZ(p, result); break;              // IORWF
+                case 0x5: result = value & w; setZ(p, result); break;              // ANDWF
+                case 0x6: result = value ^ w; setZ(p, result); break;              // XORWF
+                case 0x7: result = add(p, value, w, 0); break;                     // ADDWF
+                case 0x8: result = value; setZ(p, result); break;                  // MOVF
+                case 0x9: result = (uint8_t)~value; setZ(p, result); break;        // COMF
+                case 0xA: result = (uint8_t)(value + 1); setZ(p, result); break;   // INCF
+                case 0xB:                                                          // DECFSZ
+                    result = (uint8_t)(value - 1);
+                    if (!result)
+                    {
+                        p->pc ++;
+                        cycles = 2;
+                    }
+                    break;
+                case 0xC:                                                          // RRF
+                    result = (uint8_t)((value >> 1) | ((p->data[STATUS] & STATUSC) << 7));
+                    setFlags(p, STATUSC, value & 1);
+                    break;
+                case 0xD:                                                          // RLF
+                    result = (uint8_t)((value << 1) | (p->data[STATUS] & STATUSC));
+                    setFlags(p, STATUSC, value >> 7);
+                    break;
+                case 0xE: result = (uint8_t)((value << 4) | (value >> 4)); break;  // SWAPF
+                case 0xF:                                                          // INCFSZ
+                    result = (uint8_t)(value + 1);
+                    if (!result)
+                    {
+                        p->pc ++;
+                        cycles = 2;
+                    }
+                    break;
+                default:
+                    store = 0;
+                    break;
+            }
+            if (store)
+            {
+                if (toFile)
+                {
+                    uint8_t flags = p->data[STATUS] & 0x07;
+                    writeFile(p, address, result);
+                    if ((address & 0x7F) == STATUS)    // Flags affected by the instruction win
+                        setFlags(p, 0x07, flags);
+                }
+                else
+                    p->data[WREG] = result;
+            }
+        }
+        return cycles + extraCycles;
+    }
+
+    if ((op & 0x3000) == 0x1000)       // Bit oriented
+    {
+        uint16_t address = (uint16_t)((p->data[BSR] << 7) | (op & 0x7F));
+        uint8_t mask = (uint8_t)(1 << ((op >> 7) & 0x07));
+        switch ((op >> 10) & 0x03)
+        {
+            case 0: writeFile(p, address, readFile(p, address) & (uint8_t)~mask); break;   // BCF
+            case 1: writeFile(p, address, readFile(p, address) | mask); break;             // BSF
+            case 2:                                                                        // BTFSC
+                if (!(readFile(p, address) & mask))
+                {
+                    p->pc ++;
+                    cycles = 2;
+                }
+                break;
+            default:                                                                       // BTFSS
+                if (readFile(p, address) & mask)
+                {
+                    p->pc ++;
+                    cycles = 2;
+                }
+                break;
+        }
+        return cycles + extraCycles;
+    }
+
+    if ((op & 0x3000) == 0x2000)       // CALL, GOTO
+    {
+        uint16_t target = (uint16_t)(((p->data[PCLATH] & 0x78) << 8) | (op & 0x07FF));
+        if (!(op & 0x0800))
+            push(p, p->pc);
+        p->pc = target;
+        return 2;
+    }
+
+    // Literal and control, 11 xxxx:
+    uint8_t k = (uint8_t)op;
+    uint8_t w = p->data[WREG];
+    switch ((op >> 8) & 0x0F)
+    {
+        case 0x0: p->data[WREG] = k; break;                                        // MOVLW
+        case 0x1:
+            if (op & 0x80)
+                p->data[PCLATH] = op & 0x7F;                                       // MOVLP
+            else
+            {
+                int n = (op >> 6) & 1;                                             // ADDFSR
+                setFsr(p, n, (uint16_t)(fsr(p, n) + signExtend(op & 0x3F, 6)));
+            }
+            break;
+        case 0x2:
+        case 0x3:                                                                  // BRA
+            p->pc = (uint16_t)(p->pc + signExtend(op & 0x1FF, 9));
+            cycles = 2;
+            break;
+        case 0x4:                                                                  // RETLW
+            p->data[WREG] = k;
+            p->pc = pop(p);
+            cycles = 2;
+            break;
+        case 0x5:                                                                  // LSLF
+        case 0x6:                                                                  // LSRF
+        case 0x7:                                                                  // ASRF
+        case 0xB:                                                                  // SUBWFB
+        case 0xD:                                                                  // ADDWFC
+        {
+            uint16_t address = (uint16_t)((p->data[BSR] << 7) | (op & 0x7F));
+            uint8_t value = readFile(p, address);
+            uint8_t result;
+            int carry = p->data[STATUS] & STATUSC;
+            switch ((op >> 8) & 0x0F)
+            {
+                case 0x5:
+                    result = (uint8_t)(value << 1);
+                    setFlags(p, STATUSC, value >> 7);
+                    setZ(p, result);
+                    break;
+                case 0x6:
+                    result = value >> 1;
+                    setFlags(p, STATUSC, value & 1);
+                    setZ(p, result);
+                    break;
+                case 0x7:
+                    result = (uint8_t)((value >> 1) | (value & 0x80));
+                    setFlags(p, STATUSC, value & 1);
+                    setZ(p, result);
+                    break;
+                case 0xB:
+                    result = add(p, value, (uint8_t)~w, carry);
+                    break;
+                default:
+                    result = add(p, value, w, carry);
+                    break;
+            }
+            if (op & 0x80)
+            {
+                uint8_t flags = p->data[STATUS] & 0x07;
+                writeFile(p, address, result);
+                if ((address & 0x7F) == STATUS)
+                    setFlags(p, 0x07, flags);
+            }
+            else
+                p->data[WREG] = result;
+            break;
+        }
+        case 0x8: p->data[WREG] = w | k; setZ(p, p->data[WREG]); break;            // IORLW
+        case 0x9: p->data[WREG] = w & k; setZ(p, p->data[WREG]); break;            // ANDLW
+        case 0xA: p->data[WREG] = w ^ k; setZ(p, p->data[WREG]); break;            // XORLW
+        case 0xC: p->data[WREG] = add(p, k, (uint8_t)~w, 1); break;                // SUBLW
+        case 0xE: p->data[WREG] = add(p, w, k, 0); break;                          // ADDLW
+        case 0xF:                                                                  // MOVIW/MOVWI k[FSRn]
+        {
+            int n = (op >> 6) & 1;
+            uint16_t address = (uint16_t)(fsr(p, n) + signExtend(op & 0x3F, 6));
+            if (op & 0x80)
+                writeIndirect(p, address, w);
+            else
+            {
+                p->data[WREG] = readIndirect(p, address);
+                setZ(p, p->data[WREG]);
+            }
+            break;
+        }
+    }
+    return cycles + extraCycles;
+}
+
+static int interruptPending(pic_t *p)  // Any enabled interrupt flag, regardless of GIE
+{
+    uint8_t intcon = p->data[INTCON];
+    if ((intcon >> 3) & intcon & 0x07)
+        return 1;
+    if ((intcon & 0x40) && ((p->data[PIR1] & p->data[PIE1]) || (p->data[PIR2] & p->data[PIE2])))
+        return 1;
+    return 0;
+}
+
+static void reset(pic_t *p)
+{
+    memset(p->data, 0, sizeof(p->data));
+    p->pc = 0;
+    p->sp = 0;
+    p->data[STATUS] = 0x18;
+    p->data[TRISA] = 0x3F;
+    p->data[ANSELA] = 0x17;
+    p->data[OPTION_REG] = 0xFF;
+    p->data[OSCCON] = 0x38;            // 500kHz MFINTOSC
+    p->data[PR2] = 0xFF;
+    p->hfStartNs = -1;
+    p->pllStartNs = -1;
+    p->fvrStartNs = 0;
+    p->adcEndNs = -1;
+    p->timeNs = 0;
+    p->cycles = 0;
+    updateClock(p);
+    p->tm1637.lastClk = 1;
+    p->tm1637.lastDio = 1;
+    p->pinState = 0xFF;
+}
+
+static void step(pic_t *p)
+{
+    if (p->sleeping)
+    {
+        if (interruptPending(p))
+            p->sleeping = 0;           // Wake, vectors below if GIE set
+        else
+        {
+            stepPeripherals(p);
+            return;
+        }
+    }
+    if ((p->data[INTCON] & 0x80) && interruptPending(p))
+    {
+        push(p, p->pc);
+        p->shadow[WREG] = p->data[WREG];
+        p->shadow[STATUS] = p->data[STATUS];
+        p->shadow[BSR] = p->data[BSR];
+        p->shadow[PCLATH] = p->data[PCLATH];
+        p->shadow[FSR0L] = p->data[FSR0L];
+        p->shadow[FSR0H] = p->data[FSR0H];
+        p->shadow[FSR1L] = p->data[FSR1L];
+        p->shadow[FSR1H] = p->data[FSR1H];
+        p->data[INTCON] &= 0x7F;
+        p->pc = 0x0004;
+        p->interrupts ++;
+        for (int i = 0; i < p->intLatency; i++)
+            stepPeripherals(p);
+        return;
+    }
+    uint16_t address = p->pc & (FLASHWORDS - 1);
+    uint16_t op = p->flash[address];
+    p->pc = (uint16_t)((address + 1) & 0x7FFF);
+    int cycles = execute(p, op);
+    p->instructions ++;
+    p->execCount[address] ++;
+    p->execCycles[address] += (uint64_t)cycles;
+    for (int i = 0; i < cycles; i++)
+        stepPeripherals(p);
+}
+
+//*******************************************************************************************
+// Disassembler, used for the profile output
+//*******************************************************************************************
+
+static void disassemble(uint16_t op, uint16_t address, char *text, size_t size)
+{
+    static const char *byteOps[16] = {"MOVWF", "CLRF", "SUBWF", "DECF", "IORWF", "ANDWF", "XORWF", "ADDWF",
+                                      "MOVF", "COMF", "INCF", "DECFSZ", "RRF", "RLF", "SWAPF", "INCFSZ"};
+    static const char *bitOps[4] = {"BCF", "BSF", "BTFSC", "BTFSS"};
+    static const char *moviwModes[4] = {"++FSR%d", "--FSR%d", "FSR%d++", "FSR%d--"};
+    char operand[32];
+    int f = op & 0x7F;
+    int d = (op >> 7) & 1;
+
+    if ((op & 0x3F80) == 0x0000)
+    {
+        switch (op)
+        {
+            case 0x0000: snprintf(text, size, "NOP"); return;
+            case 0x0001: snprintf(text, size, "RESET"); return;
+            case 0x0008: snprintf(text, size, "RETURN"); return;
+            case 0x0009: snprintf(text, size, "RETFIE"); return;
+            case 0x000A: snprintf(text, size, "CALLW"); return;
+            case 0x000B: snprintf(text, size, "BRW"); return;
+            case 0x0062: snprintf(text, size, "OPTION"); return;
+            case 0x0063: snprintf(text, size, "SLEEP"); return;
+            case 0x0064: snprintf(text, size, "CLRWDT"); return;
+        }
+        if (op >= 0x0010 && op <= 0x001F)
+        {
+            snprintf(operand, sizeof(operand), moviwModes[op & 3], (op >> 2) & 1);
+            snprintf(text, size, "%s %s", (op & 0x08) ? "MOVWI" : "MOVIW", operand);
+        }
+        else if (op >= 0x0020 && op <= 0x003F)
+            snprintf(text, size, "MOVLB %d", op & 0x1F);
+        else if (op >= 0x0065 && op <= 0x0067)
+            snprintf(text, size, "TRIS %d", op & 0x07);
+        else
+            snprintf(text, size, "DW 0x%04X", op);
+        return;
+    }
+    switch (op & 0x3000)
+    {
+        case 0x0000:
+            if ((op & 0x3F00) == 0x0000)
+                snprintf(text, size, "MOVWF 0x%02X", f);
+            else if ((op & 0x3F80) == 0x0100)
+                snprintf(text, size, "CLRW");
+            else if ((op & 0x3F00) == 0x0100)
+                snprintf(text, size, "CLRF 0x%02X", f);
+            else
+                snprintf(text, size, "%s 0x%02X,%c", byteOps[(op >> 8) & 0x0F], f, d ? 'F' : 'W');
+            return;
+        case 0x1000:
+            snprintf(text, size, "%s 0x%02X,%d", bitOps[(op >> 10) & 3], f, (op >> 7) & 7);
+            return;
+        case 0x2000:
+            snprintf(text, size, "%s 0x%03X", (op & 0x0800) ? "GOTO" : "CALL", op & 0x07FF);
+            return;
+    }
+    switch ((op >> 8) & 0x0F)
+    {
+        case 0x0: snprintf(text, size, "MOVLW 0x%02X", op & 0xFF); return;
+        case 0x1:
+            if (op & 0x80)
+                snprintf(text, size, "MOVLP 0x%02X", op & 0x7F);
+            else
+                snprintf(text, size, "ADDFSR FSR%d,%d", (op >> 6) & 1, signExtend(op & 0x3F, 6));
+            return;
+        case 0x2:
+        case 0x3:
+            snprintf(text, size, "BRA 0x%03X", (address + 1 + signExtend(op & 0x1FF, 9)) & 0x7FFF);
+            return;
+        case 0x4: snprintf(text, size, "RETLW 0x%02X", op & 0xFF); return;
+        case 0x5: snprintf(text, size, "LSLF 0x%02X,%c", f, d ? 'F' : 'W'); return;
+        case 0x6: snprintf(text, size, "LSRF 0x%02X,%c", f, d ? 'F' : 'W'); return;
+        case 0x7: snprintf(text, size, "ASRF 0x%02X,%c", f, d ? 'F' : 'W'); return;
+        case 0x8: snprintf(text, size, "IORLW 0x%02X", op & 0xFF); return;
+        case 0x9: snprintf(text, size, "ANDLW 0x%02X", op & 0xFF); return;
+        case 0xA: snprintf(text, size, "XORLW 0x%02X", op & 0xFF); return;
+        case 0xB: snprintf(text, size, "SUBWFB 0x%02X,%c", f, d ? 'F' : 'W'); return;
+        case 0xC: snprintf(text, size, "SUBLW 0x%02X", op & 0xFF); return;
+        case 0xD: snprintf(text, size, "ADDWFC 0x%02X,%c", f, d ? 'F' : 'W'); return;
+        case 0xE: snprintf(text, size, "ADDLW 0x%02X", op & 0xFF); return;
+        default:
+            snprintf(text, size, "%s %d[FSR%d]", (op & 0x80) ? "MOVWI" : "MOVIW",
+                     signExtend(op & 0x3F, 6), (op >> 6) & 1);
+            return;
+    }
+}
+
+//*******************************************************************************************
+// Reports
+//*******************************************************************************************
+
+static void writeVcdHeader(FILE *vcd)
+{
+    fprintf(vcd, "$timescale 1ns $end\n$scope module pic12f1840 $end\n");
+    for (int pin = 0; pin < PINS; pin++)
+        fprintf(vcd, "$var wire 1 %c RA%d $end\n", '0' + pin, pin);
+    fprintf(vcd, "$upscope $end\n$enddefinitions $end\n");
+}
+
+static int compareCycles(const void *a, const void *b)
+{
+    uint16_t addressA = *(const uint16_t *)a;
+    uint16_t addressB = *(const uint16_t *)b;
+    if (pic.execCycles[addressA] != pic.execCycles[addressB])
+        return pic.execCycles[addressA] < pic.execCycles[addressB] ? 1 : -1;
+    return addressA - addressB;
+}
+
+static void report(pic_t *p, int top, const char *profileName)
+{
+    uint16_t addresses[FLASHWORDS];
+    int executed = 0;
+    char text[40];
+
+    printf("\nSimulated time    %.3f ms\n", p->timeNs / 1e6);
+    printf("Instruction cycles %llu\n", (unsigned long long)p->cycles);
+    printf("Instructions      %llu\n", (unsigned long long)p->instructions);
+    printf("Interrupts        %llu\n", (unsigned long long)p->interrupts);
+    printf("Final clock       %.0f Hz\n", p->fosc);
+    if (p->tm1637.attached)
+    {
+        printf("Display updates   %ld", p->tm1637.updates);
+        if (p->tm1637.updates)
+            printf(", first at %.3f ms", p->tm1637.firstUpdateNs / 1e6);
+        printf("\n");
+    }
+    if (p->halted)
+        printf("Halted            %s at PC 0x%03X\n", p->haltReason, p->pc);
+
+    for (int i = 0; i < FLASHWORDS; i++)
+        if (p->execCount[i])
+            addresses[executed++] = (uint16_t)i;
+    qsort(addresses, (size_t)executed, sizeof(uint16_t), compareCycles);
+    printf("\nHot spots, by cycles (%d addresses executed):\n", executed);
+    printf("  addr      count        cycles      %%  instruction\n");
+    for (int i = 0; i < executed && i < top; i++)
+    {
+        uint16_t address = addresses[i];
+        disassemble(p->flash[address], address, text, sizeof(text));
+        printf("  0x%03X %10llu %13llu %6.2f  %s\n", address, (unsigned long long)p->execCount[address],
+               (unsigned long long)p->execCycles[address], 100.0 * (double)p->execCycles[address] / (double)p->cycles,
+               text);
+    }
+
+    if (profileName)
+    {
+        FILE *profile = fopen(profileName, "w");
+        if (!profile)
+        {
+            fprintf(stderr, "Cannot write %s\n", profileName);
+            return;
+        }
+        fprintf(profile, "address,count,cycles,instruction\n");
+        for (int i = 0; i < FLASHWORDS; i++)
+        {
+            if (!p->execCount[i])
+                continue;
+            disassemble(p->flash[i], (uint16_t)i, text, sizeof(text));
+            fprintf(profile, "0x%03X,%llu,%llu,%s\n", i, (unsigned long long)p->execCount[i],
+                    (unsigned long long)p->execCycles[i], text);
+        }
+        fclose(profile);
+    }
+}
+
+//*******************************************************************************************
+// Command line
+//*******************************************************************************************
+
+static int parsePin(const char *text, int *pin, const char **rest)
+{
+    if (strncmp(text, "RA", 2) || text[2] < '0' || text[2] > '5' || text[3] != '=')
+        return 0;
+    *pin = text[2] - '0';
+    *rest = text + 4;
+    return 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [--ms N] [--updates N] [--an N=mV] [--vdd mV] [--pin RAn=0|1]\n"
+                    "       [--square RAn=Hz[:duty%%]] [--no-tm1637] [--int-latency 3..5] [--vcd file]\n"
+                    "       [--profile file] [--top N] [--quiet] image.hex\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    double runMs = 3000;
+    long stopUpdates = 0;
+    int top = 15;
+    const char *hexName = NULL;
+    const char *vcdName = NULL;
+    const char *profileName = NULL;
+    pic_t *p = &pic;
+
+    p->vddMv = 5000;
+    p->tm1637.attached = 1;
+    p->intLatency = 3;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int pin;
+        const char *rest;
+        if (!strcmp(arg, "--ms") && value)
+            runMs = atof(argv[++i]);
+        else if (!strcmp(arg, "--updates") && value)
+            stopUpdates = atol(argv[++i]);
+        else if (!strcmp(arg, "--an") && value && value[0] >= '0' && value[0] <= '3' && value[1] == '=')
+        {
+            p->anMv[value[0] - '0'] = atof(value + 2);
+            i ++;
+        }
+        else if (!strcmp(arg, "--vdd") && value)
+            p->vddMv = atof(argv[++i]);
+        else if (!strcmp(arg, "--pin") && value && parsePin(value, &pin, &rest))
+        {
+            p->input[pin].active = 1;
+            p->input[pin].level = atoi(rest) ? 1 : 0;
+            i ++;
+        }
+        else if (!strcmp(arg, "--square") && value && parsePin(value, &pin, &rest))
+        {
+            double hz = atof(rest);
+            const char *colon = strchr(rest, ':');
+            double duty = colon ? atof(colon + 1) : 50.0;
+            if (hz <= 0)
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            p->input[pin].active = 1;
+            p->input[pin].periodNs = 1e9 / hz;
+            p->input[pin].highNs = p->input[pin].periodNs * duty / 100.0;
+            i ++;
+        }
+        else if (!strcmp(arg, "--no-tm1637"))
+            p->tm1637.attached = 0;
+        else if (!strcmp(arg, "--int-latency") && value)
+        {
+            p->intLatency = atoi(argv[++i]);
+            if (p->intLatency < 3 || p->intLatency > 5)
+            {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        else if (!strcmp(arg, "--vcd") && value)
+            vcdName = argv[++i];
+        else if (!strcmp(arg, "--profile") && value)
+            profileName = argv[++i];
+        else if (!strcmp(arg, "--top") && value)
+            top = atoi(argv[++i]);
+        else if (!strcmp(arg, "--quiet"))
+            p->quiet = 1;
+        else if (arg[0] != '-' && !hexName)
+            hexName = arg;
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!hexName)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    p->execCount = calloc(FLASHWORDS, sizeof(uint64_t));
+    p->execCycles = calloc(FLASHWORDS, sizeof(uint64_t));
+    if (!p->execCount || !p->execCycles || !loadHex(p, hexName))
+        return 1;
+    if (vcdName)
+    {
+        p->vcd = fopen(vcdName, "w");
+        if (!p->vcd)
+        {
+            fprintf(stderr, "Cannot write %s\n", vcdName);
+            return 1;
+        }
+        writeVcdHeader(p->vcd);
+    }
+
+    reset(p);
+    while (!p->halted && p->timeNs < runMs * 1e6)
+    {
+        step(p);
+        if (stopUpdates && p->tm1637.updates >= stopUpdates)
+            break;
+    }
+    report(p, top, profileName);
+    if (p->vcd)
+        fclose(p->vcd);
+    free(p->execCount);
+    free(p->execCycles);
+    return p->halted ? 1 : 0;
+}
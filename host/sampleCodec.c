@@ -0,0 +1,399 @@
+// ---------------------------------------------------------------------
+// Host side decoder and benchmark for the ADC sample stream codec used by
+// encodeSample() in PIC12F1840ADC.c. Standard C, build with eg.:
+//     cc -O2 -o sampleCodec host/sampleCodec.c
+//
+// Usage:
+//     sampleCodec decode < stream.bin        Prints "channel sample" per decoded sample
+//     sampleCodec encode [channel] < samples.txt > stream.bin
+//                                            Encodes one 10 bit sample per line
+//     sampleCodec bench [trace.txt ...]      Synthetic traces, plus any trace files given
+//                                            (one sample per line, # starts a comment), reporting
+//                                            compression ratio and how often each encoder path runs
+//
+// host/cpuload.trace is PC CPU load used as a stand-in, it is not an ADC recording, see its header.
+// The encoder cost is only given per path, as the CYCLES* estimates, it has not been measured on the
+// compiled encodeSample().
+//
+// Stream format, see the codec definitions in PIC12F1840ADC.c:
+//     0xxxxxxx                   delta, zigzag value 0..127
+//     1000hhhh 0lllllll          delta, zigzag value 128..2047
+//     111100cc 0000hhh 0lllllll  keyframe for channel cc, full 10 bit sample
+// -----------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define CODECKEYMARKER 0xF0            // As PIC12F1840ADC.c
+#define CODECKEYINTERVAL 32
+#define CODECNOCHANNEL 0xFF
+#define CODECCHANNELS 4                // Keyframes can carry channels 0..3
+#define ADCMAX 1023
+#define PI 3.14159265358979
+
+// Cycle estimates for each encoder path, instruction cycles on the enhanced mid-range core
+// for encodeSample() as written, allowing for XC8 free mode code: call and parameters, array
+// indexing via FSR, 16 bit subtract and shift, ring buffer index updates. These are rough
+// estimates, not measurements, 1 cycle = 125ns at 32 MHz.
+#define CYCLESKEYFRAME 110
+#define CYCLESDELTA1 90
+#define CYCLESDELTA2 110
+#define RAWBYTESPERSAMPLE 2            // Uncoded 10 bit sample sent as 2 bytes, no framing
+
+typedef struct
+{
+    uint16_t previous[CODECCHANNELS];
+    uint8_t countdown[CODECCHANNELS];
+    uint8_t lastChannel;
+    uint32_t keyframes;                // Samples sent by each encoder path
+    uint32_t deltas1;
+    uint32_t deltas2;
+} encoder_t;
+
+typedef struct
+{
+    uint8_t synced;                    // Set after the first keyframe
+    uint8_t channel;
+    uint16_t previous[CODECCHANNELS];
+    uint8_t state;                     // Bytes still expected for the current code
+    uint8_t code;                      // First byte of the current code
+    uint8_t high;                      // Keyframe high bits
+    uint32_t errors;                   // Invalid bytes seen, each loses sync until the next keyframe
+} decoder_t;
+
+//*******************************************************************************************
+// Encoder, mirrors encodeSample() in PIC12F1840ADC.c without the transmit buffer limit.
+// Returns the number of bytes written to out, 1..3
+//*******************************************************************************************
+
+static int encodeSample(encoder_t *enc, uint8_t channel, uint16_t sample, uint8_t *out)
+{
+    int length;
+    if (enc->countdown[channel] == 0 || channel != enc->lastChannel)
+    {
+        out[0] = CODECKEYMARKER | channel;
+        out[1] = (uint8_t)(sample >> 7);
+        out[2] = (uint8_t)sample & 0x7F;
+        length = 3;
+        enc->lastChannel = channel;
+        enc->countdown[channel] = CODECKEYINTERVAL - 1;
+        enc->keyframes ++;
+    }
+    else
+    {
+        int16_t delta = (int16_t)(sample - enc->previous[channel]);
+        uint16_t zigzag = delta < 0 ? ((uint16_t)(-delta) << 1) - 1 : (uint16_t)delta << 1;
+        if (zigzag < 0x80)
+        {
+            out[0] = (uint8_t)zigzag;
+            length = 1;
+            enc->deltas1 ++;
+        }
+        else
+        {
+            out[0] = 0x80 | (uint8_t)(zigzag >> 7);
+            out[1] = (uint8_t)zigzag & 0x7F;
+            length = 2;
+            enc->deltas2 ++;
+        }
+        enc->countdown[channel] --;
+    }
+    enc->previous[channel] = sample;
+    return length;
+}
+
+//*******************************************************************************************
+// Decoder, feed one byte at a time. Returns 1 and sets channel/sample when a sample is complete
+//*******************************************************************************************
+
+static int decodeByte(decoder_t *dec, uint8_t in, uint8_t *channel, uint16_t *sample)
+{
+    if ((in & 0xFC) == CODECKEYMARKER)          // Keyframe marker always restarts decoding
+    {
+        dec->code = in;
+        dec->state = 2;
+        return 0;
+    }
+    if (dec->state)                              // Continuation byte of a code
+    {
+        if (in & 0x80)                           // Continuation bytes are always 0..0x7F
+        {
+            dec->state = 0;
+            dec->synced = 0;
+            dec->errors ++;
+            return 0;
+        }
+        if ((dec->code & 0xFC) == CODECKEYMARKER)
+        {
+            if (dec->state == 2)
+            {
+                dec->high = in;
+                dec->state = 1;
+                return 0;
+            }
+            dec->state = 0;
+            if (dec->high > (ADCMAX >> 7))
+            {
+                dec->synced = 0;
+                dec->errors ++;
+                return 0;
+            }
+            dec->channel = dec->code & 0x03;
+            dec->previous[dec->channel] = ((uint16_t)dec->high << 7) | in;
+            dec->synced = 1;
+        }
+        else
+        {
+            dec->state = 0;
+            uint16_t zigzag = ((uint16_t)(dec->code & 0x0F) << 7) | in;
+            if (!dec->synced)
+                return 0;
+            int16_t delta = (zigzag & 1) ? -(int16_t)((zigzag + 1) >> 1) : (int16_t)(zigzag >> 1);
+            dec->previous[dec->channel] = (uint16_t)(dec->previous[dec->channel] + delta);
+        }
+        *channel = dec->channel;
+        *sample = dec->previous[dec->channel];
+        return 1;
+    }
+    if (in < 0x80)                               // 1 byte delta
+    {
+        if (!dec->synced)
+            return 0;
+        int16_t delta = (in & 1) ? -(int16_t)((in + 1) >> 1) : (int16_t)(in >> 1);
+        dec->previous[dec->channel] = (uint16_t)(dec->previous[dec->channel] + delta);
+        *channel = dec->channel;
+        *sample = dec->previous[dec->channel];
+        return 1;
+    }
+    if (in < 0x90)                               // First byte of a 2 byte delta
+    {
+        dec->code = in;
+        dec->state = 1;
+        return 0;
+    }
+    dec->synced = 0;                             // 0x90..0xEF, 0xF4..0xFF are never sent
+    dec->errors ++;
+    return 0;
+}
+
+//*******************************************************************************************
+// Traces
+//*******************************************************************************************
+
+static uint32_t lcgState = 12345;
+
+static uint32_t lcgRandom(void)                  // Deterministic noise so results are repeatable
+{
+    lcgState = lcgState * 1103515245u + 12345u;
+    return (lcgState >> 16) & 0x7FFF;
+}
+
+static uint16_t clampSample(long value)
+{
+    if (value < 0)
+        return 0;
+    if (value > ADCMAX)
+        return ADCMAX;
+    return (uint16_t)value;
+}
+
+#define SYNTHETICLENGTH 3600            // One hour at the demo's 1 sample/sec
+
+static size_t syntheticTrace(int type, uint16_t *samples)
+{
+    long walk = 512;
+    for (size_t i = 0; i < SYNTHETICLENGTH; i++)
+    {
+        long noise = (long)(lcgRandom() % 3) - 1;                 // +/-1 LSB
+        switch (type)
+        {
+            case 0:                                               // Steady input with LSB noise
+                samples[i] = clampSample(600 + noise);
+                break;
+            case 1:                                               // Slow sine, eg. temperature over a day
+                samples[i] = clampSample(512 + lround(200.0 * sin(2.0 * PI * i / 900.0)) + noise);
+                break;
+            case 2:                                               // Random walk
+                walk += (long)(lcgRandom() % 9) - 4;
+                samples[i] = clampSample(walk);
+                if (walk < 0 || walk > ADCMAX)
+                    walk = samples[i];
+                break;
+            case 3:                                               // Steps every 60 samples
+                samples[i] = clampSample(((i / 60) % 2 ? 900 : 100) + noise);
+                break;
+            default:                                              // Full scale noise, worst case
+                samples[i] = (uint16_t)(lcgRandom() % (ADCMAX + 1));
+                break;
+        }
+    }
+    return SYNTHETICLENGTH;
+}
+
+static const char *syntheticNames[] = {"steady+noise", "slow sine", "random walk", "steps", "full scale noise"};
+#define SYNTHETICTRACES 5
+
+static size_t readTrace(FILE *file, uint16_t **samples)
+{
+    size_t capacity = 1024;
+    size_t count = 0;
+    char line[256];
+    long value;
+    *samples = malloc(capacity * sizeof(uint16_t));
+    while (*samples && fgets(line, sizeof(line), file))
+    {
+        if (sscanf(line, " %ld", &value) != 1)     // Comment or blank line
+            continue;
+        if (count == capacity)
+        {
+            capacity *= 2;
+            *samples = realloc(*samples, capacity * sizeof(uint16_t));
+            if (!*samples)
+                break;
+        }
+        (*samples)[count++] = clampSample(value);
+    }
+    return *samples ? count : 0;
+}
+
+//*******************************************************************************************
+// Benchmark one trace: encode, decode and check the round trip, then check a receiver
+// joining part way through a code resyncs at the next keyframe
+//*******************************************************************************************
+
+static int benchTrace(const char *name, const uint16_t *samples, size_t count)
+{
+    encoder_t enc;
+    decoder_t dec;
+    uint8_t *stream = malloc(count * 3 + 1);
+    size_t streamLength = 0;
+    size_t decoded = 0;
+    uint8_t channel;
+    uint16_t sample;
+    int failed = 0;
+
+    if (!stream)
+        return 1;
+    memset(&enc, 0, sizeof(enc));
+    enc.lastChannel = CODECNOCHANNEL;
+    for (size_t i = 0; i < count; i++)
+        streamLength += encodeSample(&enc, 0, samples[i], stream + streamLength);
+
+    memset(&dec, 0, sizeof(dec));
+    for (size_t i = 0; i < streamLength; i++)
+    {
+        if (decodeByte(&dec, stream[i], &channel, &sample))
+        {
+            if (decoded >= count || sample != samples[decoded] || channel != 0)
+                failed = 1;
+            decoded ++;
+        }
+    }
+    if (decoded != count)
+        failed = 1;
+
+    memset(&dec, 0, sizeof(dec));                // Join the stream at byte 1, mid keyframe
+    size_t firstResync = 0;
+    for (size_t i = 1; i < streamLength; i++)
+    {
+        if (decodeByte(&dec, stream[i], &channel, &sample))
+        {
+            firstResync = i;
+            break;
+        }
+    }
+
+    printf("%-18s %7zu %9zu %9zu %6.2f:1 %6.3f %4.0f%% %4.0f%% %4.0f%% %7zu  %s\n", name, count,
+           count * RAWBYTESPERSAMPLE, streamLength,
+           (double)(count * RAWBYTESPERSAMPLE) / (double)streamLength,
+           (double)streamLength / (double)count, 100.0 * enc.keyframes / count,
+           100.0 * enc.deltas1 / count, 100.0 * enc.deltas2 / count, firstResync,
+           failed ? "FAIL" : "ok");
+    free(stream);
+    return failed;
+}
+
+static int runBench(int argc, char **argv)
+{
+    uint16_t *samples = malloc(SYNTHETICLENGTH * sizeof(uint16_t));
+    int failed = 0;
+
+    if (!samples)
+        return 1;
+    printf("Keyframe every %d samples, raw size %d bytes/sample. key, d1, d2 are the share of samples\n"
+           "sent as a keyframe, 1 byte or 2 byte delta. Encoder cost per path is estimated, not measured:\n"
+           "~%d cycles per keyframe, ~%d per 1 byte delta, ~%d per 2 byte delta\n",
+           CODECKEYINTERVAL, RAWBYTESPERSAMPLE, CYCLESKEYFRAME, CYCLESDELTA1, CYCLESDELTA2);
+    printf("%-18s %7s %9s %9s %8s %6s %5s %5s %5s %7s  %s\n", "trace", "samples", "raw bytes", "coded",
+           "ratio", "B/smp", "key", "d1", "d2", "resync@", "roundtrip");
+    for (int type = 0; type < SYNTHETICTRACES; type++)
+    {
+        size_t count = syntheticTrace(type, samples);
+        failed |= benchTrace(syntheticNames[type], samples, count);
+    }
+    free(samples);
+
+    for (int i = 0; i < argc; i++)                // Trace files
+    {
+        FILE *file = fopen(argv[i], "r");
+        uint16_t *recorded;
+        if (!file)
+        {
+            fprintf(stderr, "Cannot open %s\n", argv[i]);
+            failed = 1;
+            continue;
+        }
+        size_t count = readTrace(file, &recorded);
+        fclose(file);
+        if (count)
+            failed |= benchTrace(argv[i], recorded, count);
+        free(recorded);
+    }
+    return failed;
+}
+
+static int runDecode(void)
+{
+    decoder_t dec;
+    int in;
+    uint8_t channel;
+    uint16_t sample;
+
+    memset(&dec, 0, sizeof(dec));
+    while ((in = getchar()) != EOF)
+    {
+        if (decodeByte(&dec, (uint8_t)in, &channel, &sample))
+            printf("%u %u\n", channel, sample);
+    }
+    if (dec.errors)
+        fprintf(stderr, "%lu invalid bytes, resynced at following keyframes\n", (unsigned long)dec.errors);
+    return 0;
+}
+
+static int runEncode(uint8_t channel)
+{
+    encoder_t enc;
+    uint8_t out[3];
+    long value;
+
+    memset(&enc, 0, sizeof(enc));
+    enc.lastChannel = CODECNOCHANNEL;
+    while (scanf("%ld", &value) == 1)
+        fwrite(out, 1, encodeSample(&enc, channel, clampSample(value), out), stdout);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && !strcmp(argv[1], "decode"))
+        return runDecode();
+    if (argc >= 2 && !strcmp(argv[1], "encode"))
+        return runEncode(argc >= 3 ? (uint8_t)(atoi(argv[2]) & 0x03) : 0);
+    if (argc >= 2 && !strcmp(argv[1], "bench"))
+        return runBench(argc - 2, argv + 2);
+    fprintf(stderr, "Usage: %s decode | encode [channel] | bench [trace.txt ...]\n", argv[0]);
+    return 2;
+}
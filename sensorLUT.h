@@ -0,0 +1,15 @@
+// Generated by host/lutGenerator.c from host/ntc10k.curve, do not edit, regenerate with:
+//     lutGenerator host/ntc10k.curve > sensorLUT.h
+// NTC thermistor, R25 = 10000, beta = 3950, low side of a divider with 10000 ohms, supply 5000mV, ADC Vref 4096mV.
+// Table values are in units of 0.1, clamped to 0..1000.
+
+#define SENSORLUTSHIFT 5               // ADC counts per table entry = 1 << SENSORLUTSHIFT
+#define SENSORLUTSIZE 33               // Entries, 1024 / step + 1
+#define SENSORDECIMALS 1               // Digits after the decimal point when displayed
+#define SENSORMIN 0                    // Output clamp, table units
+#define SENSORMAX 1000
+
+const int16_t sensorLUT[SENSORLUTSIZE] = {
+    1000, 1000, 1085, 934, 831, 753, 689, 636, 589, 548, 510,
+    476, 444, 415, 387, 360, 334, 309, 285, 262, 239, 216,
+    194, 171, 148, 126, 102, 79, 54, 29, 3, -26, 0};